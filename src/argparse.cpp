@@ -19,6 +19,30 @@ void printOptionInstructions() {
     std::cout << "\t[Required]--theta or -t <threshold for MAC (double)>" << std::endl;
     std::cout << "\t[Required]--dt or -d <timestep (double)>" << std::endl;
     std::cout << "\t[Optional] -v <flag to turn on visualization window>" << std::endl;
+    std::cout << "\t[Optional] --build or -b <tree build: insert, morton, shared or update (default: morton)>" << std::endl;
+    std::cout << "\t[Optional] --simd or -x <force kernel instruction set: auto, avx512, avx2 or scalar (default: auto)>" << std::endl;
+    std::cout << "\t[Optional] --group-size or -g <bodies sharing one tree walk, 1 walks the tree per body (default: 1)>" << std::endl;
+    std::cout << "\t[Optional] --leaf-size or -l <bodies a tree leaf holds before it is split (default: 1)>" << std::endl;
+    std::cout << "\t[Optional] --threads or -n <threads per process (default: 1)>" << std::endl;
+    std::cout << "\t[Optional] --pin or -p <core pinning: none, rank or thread (default: none)>" << std::endl;
+    std::cout << "\t[Optional] --verify-tree or -T <flag to check the first step's parallel tree build against a sequential build and a TreeNode insert build>" << std::endl;
+    std::cout << "\t[Optional] --distributed or -D <flag to split the bodies across processes instead of giving every process all of them>" << std::endl;
+    std::cout << "\t[Optional] --balance or -B <work split across processes: count or cost (default: cost)>" << std::endl;
+    std::cout << "\t[Optional] --log-imbalance or -L <flag to print every step's load imbalance (max / mean work of the processes)>" << std::endl;
+    std::cout << "\t[Optional] --chunks or -c <chunks each process shares its bodies in while it works on the next one (default: 4)>" << std::endl;
+    std::cout << "\t[Optional] --float-positions or -F <flag to exchange positions between processes as floats, rounding them every step>" << std::endl;
+    std::cout << "\t[Optional] --integrator or -I <verlet or kdk (default: verlet)>" << std::endl;
+    std::cout << "\t[Optional] --checkpoint or -k <checkpoint file prefix, the run restarts from its newest checkpoint>" << std::endl;
+    std::cout << "\t[Optional] --checkpoint-every or -K <steps between checkpoints (default: 0, none)>" << std::endl;
+    std::cout << "\t[Optional] --checkpoint-seconds or -W <seconds between checkpoints (default: 0, none)>" << std::endl;
+    std::cout << "\t[Optional] --snapshot-every or -S <steps between snapshots of the positions (default: 0, none)>" << std::endl;
+    std::cout << "\t[Optional] --trajectory or -j <trajectory file the snapshots are appended to (default: output file with .trj appended)>" << std::endl;
+    std::cout << "\t[Optional] --profile or -P <file the per-step phase times and counters of every process are written to, as CSV if it ends in .csv and JSON otherwise>" << std::endl;
+    std::cout << "\t[Optional] --rebuild-threshold or -R <fraction of the bodies that may move to another leaf before -b update rebuilds the tree (default: 0.1)>" << std::endl;
+    std::cout << "\t[Optional] --opening or -O <node size the opening criterion compares against theta: size (space length) or bmax (distance to the farthest body) (default: size)>" << std::endl;
+    std::cout << "\t[Optional] --multipole-order or -M <highest moment of a node used for its force: 0 or 1 for the center of mass alone, 2 to add the quadrupole moments (default: 0)>" << std::endl;
+    std::cout << "\t[Optional] --solver or -f <force solver: bh, fmm or direct (default: bh)>" << std::endl;
+    std::cout << "\t[Optional] --tolerance or -e <relative force error the fmm solver picks its expansion order for (default: 0.001)>" << std::endl;
     exit(0);
 }
 
@@ -33,6 +57,30 @@ void get_opts(int               argc,
 
     // Set flag values.
     opts->visualization = false;
+    opts->tree_build = TREE_BUILD_MORTON;
+    opts->simd = "auto";
+    opts->group_size = 1;
+    opts->leaf_size = 1;
+    opts->threads = 1;
+    opts->pin = PIN_NONE;
+    opts->verify_tree = false;
+    opts->distributed = false;
+    opts->balance = BALANCE_COST;
+    opts->log_imbalance = false;
+    opts->chunks = 4;
+    opts->float_positions = false;
+    opts->integrator = INTEGRATOR_VERLET;
+    opts->checkpoint_prefix = nullptr;
+    opts->checkpoint_every = 0;
+    opts->checkpoint_seconds = 0;
+    opts->snapshot_every = 0;
+    opts->trajectory_filename = nullptr;
+    opts->profile_filename = nullptr;
+    opts->rebuild_threshold = 0.1;
+    opts->opening = OPENING_SIZE;
+    opts->multipole_order = 0;
+    opts->solver = SOLVER_BH;
+    opts->tolerance = 0.001;
 
     // Set required options.
     map<string, bool> required_options_map{
@@ -49,11 +97,36 @@ void get_opts(int               argc,
         {"steps", required_argument, NULL, 's'},
         {"theta", required_argument, NULL, 't'},
         {"dt", required_argument, NULL, 'd'},
-        {"v", no_argument, NULL, 'v'}
+        {"v", no_argument, NULL, 'v'},
+        {"build", required_argument, NULL, 'b'},
+        {"simd", required_argument, NULL, 'x'},
+        {"group-size", required_argument, NULL, 'g'},
+        {"leaf-size", required_argument, NULL, 'l'},
+        {"threads", required_argument, NULL, 'n'},
+        {"pin", required_argument, NULL, 'p'},
+        {"verify-tree", no_argument, NULL, 'T'},
+        {"distributed", no_argument, NULL, 'D'},
+        {"balance", required_argument, NULL, 'B'},
+        {"log-imbalance", no_argument, NULL, 'L'},
+        {"chunks", required_argument, NULL, 'c'},
+        {"float-positions", no_argument, NULL, 'F'},
+        {"integrator", required_argument, NULL, 'I'},
+        {"checkpoint", required_argument, NULL, 'k'},
+        {"checkpoint-every", required_argument, NULL, 'K'},
+        {"checkpoint-seconds", required_argument, NULL, 'W'},
+        {"snapshot-every", required_argument, NULL, 'S'},
+        {"trajectory", required_argument, NULL, 'j'},
+        {"profile", required_argument, NULL, 'P'},
+        {"rebuild-threshold", required_argument, NULL, 'R'},
+        {"opening", required_argument, NULL, 'O'},
+        {"multipole-order", required_argument, NULL, 'M'},
+        {"solver", required_argument, NULL, 'f'},
+        {"tolerance", required_argument, NULL, 'e'},
+        {0, 0, 0, 0}
     };
 
     int ind, c;
-    while ((c = getopt_long(argc, argv, "i:o:s:t:d:v", l_opts, &ind)) != -1)
+    while ((c = getopt_long(argc, argv, "i:o:s:t:d:vb:x:g:l:n:p:TDB:Lc:FI:k:K:W:S:j:P:R:O:M:f:e:", l_opts, &ind)) != -1)
     {
         //printf("argparse: s value: %d \n", s);  // debug statement
         switch (c)
@@ -85,6 +158,136 @@ void get_opts(int               argc,
         case 'v':
             opts->visualization = true;
             break;
+        case 'b':
+            if (string(optarg) == "insert") {
+                opts->tree_build = TREE_BUILD_INSERT;
+            } else if (string(optarg) == "morton") {
+                opts->tree_build = TREE_BUILD_MORTON;
+            } else if (string(optarg) == "shared") {
+                opts->tree_build = TREE_BUILD_SHARED;
+            } else if (string(optarg) == "update") {
+                opts->tree_build = TREE_BUILD_UPDATE;
+            } else {
+                std::cerr << argv[0] << ": option -b must be insert, morton, shared or update." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'x':
+            opts->simd = (char *)optarg;
+            break;
+        case 'g':
+            opts->group_size = atoi((char *)optarg);
+            break;
+        case 'l':
+            opts->leaf_size = atoi((char *)optarg);
+            break;
+        case 'n':
+            opts->threads = atoi((char *)optarg);
+            break;
+        case 'p':
+            if (string(optarg) == "none") {
+                opts->pin = PIN_NONE;
+            } else if (string(optarg) == "rank") {
+                opts->pin = PIN_RANK;
+            } else if (string(optarg) == "thread") {
+                opts->pin = PIN_THREAD;
+            } else {
+                std::cerr << argv[0] << ": option -p must be none, rank or thread." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'T':
+            opts->verify_tree = true;
+            break;
+        case 'D':
+            opts->distributed = true;
+            break;
+        case 'B':
+            if (string(optarg) == "count") {
+                opts->balance = BALANCE_COUNT;
+            } else if (string(optarg) == "cost") {
+                opts->balance = BALANCE_COST;
+            } else {
+                std::cerr << argv[0] << ": option -B must be count or cost." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'L':
+            opts->log_imbalance = true;
+            break;
+        case 'c':
+            opts->chunks = atoi((char *)optarg);
+            break;
+        case 'F':
+            opts->float_positions = true;
+            break;
+        case 'I':
+            if (string(optarg) == "verlet") {
+                opts->integrator = INTEGRATOR_VERLET;
+            } else if (string(optarg) == "kdk") {
+                opts->integrator = INTEGRATOR_KDK;
+            } else {
+                std::cerr << argv[0] << ": option -I must be verlet or kdk." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'k':
+            opts->checkpoint_prefix = (char *)optarg;
+            break;
+        case 'K':
+            opts->checkpoint_every = atoi((char *)optarg);
+            break;
+        case 'W':
+            opts->checkpoint_seconds = atof((char *)optarg);
+            break;
+        case 'S':
+            opts->snapshot_every = atoi((char *)optarg);
+            break;
+        case 'j':
+            opts->trajectory_filename = (char *)optarg;
+            break;
+        case 'P':
+            opts->profile_filename = (char *)optarg;
+            break;
+        case 'R':
+            opts->rebuild_threshold = atof((char *)optarg);
+            break;
+        case 'O':
+            if (string(optarg) == "size") {
+                opts->opening = OPENING_SIZE;
+            } else if (string(optarg) == "bmax") {
+                opts->opening = OPENING_BMAX;
+            } else {
+                std::cerr << argv[0] << ": option -O must be size or bmax." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'M':
+            opts->multipole_order = atoi((char *)optarg);
+            if (opts->multipole_order < 0 || opts->multipole_order > 2) {
+                std::cerr << argv[0] << ": option -M must be 0, 1 or 2." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'f':
+            if (string(optarg) == "bh") {
+                opts->solver = SOLVER_BH;
+            } else if (string(optarg) == "fmm") {
+                opts->solver = SOLVER_FMM;
+            } else if (string(optarg) == "direct") {
+                opts->solver = SOLVER_DIRECT;
+            } else {
+                std::cerr << argv[0] << ": option -f must be bh, fmm or direct." << std::endl;
+                exit(0);
+            }
+            break;
+        case 'e':
+            opts->tolerance = atof((char *)optarg);
+            if (opts->tolerance <= 0 || opts->tolerance >= 1) {
+                std::cerr << argv[0] << ": option -e must be between 0 and 1." << std::endl;
+                exit(0);
+            }
+            break;
         case ':':
             std::cerr << argv[0] << ": option -" << (char)optopt << " requires an argument." << std::endl;
             exit(0);
@@ -1,5 +1,45 @@
 #pragma once
 
+// Ways of building the Barnes-Hut Tree every step.
+enum tree_build_t {
+    TREE_BUILD_INSERT,  // Insert the bodies one at a time from the root.
+    TREE_BUILD_MORTON,  // Sort the bodies by Morton key and build the tree in bulk.
+    TREE_BUILD_SHARED,  // Like TREE_BUILD_MORTON, with the processes of a replicated run each building a share of the subtrees.
+    TREE_BUILD_UPDATE   // Keep the tree between steps, moving only the bodies that left their leaf, and rebuild it like TREE_BUILD_MORTON once too many did.
+};
+
+// Size of a tree node the opening criterion compares against theta times the distance to it.
+enum opening_t {
+    OPENING_SIZE,  // The side length of the node's space.
+    OPENING_BMAX   // The distance from the node's center of mass to its farthest body.
+};
+
+// How processes and their threads are pinned to cores.
+enum pin_t {
+    PIN_NONE,   // Leave placement to the operating system.
+    PIN_RANK,   // Bind each process to its own set of cores.
+    PIN_THREAD  // Bind each thread to its own core.
+};
+
+// How the work of a step is split across processes.
+enum balance_t {
+    BALANCE_COUNT,  // Give every process about as many bodies.
+    BALANCE_COST    // Give every process about as many interactions, counted during the last step.
+};
+
+// How a step moves the bodies once their net force is known.
+enum integrator_t {
+    INTEGRATOR_VERLET,  // Update position and velocity from the net force at the start of the step.
+    INTEGRATOR_KDK      // Kick-drift-kick leapfrog with velocities staggered half a step behind.
+};
+
+// How the net forces of a step are calculated.
+enum solver_t {
+    SOLVER_BH,     // Barnes-Hut: walk the tree for every body, or group of bodies, and use far nodes as a whole.
+    SOLVER_FMM,    // Fast multipole method: node-to-node expansions over the same tree, evaluated at every body.
+    SOLVER_DIRECT  // Sum up every pair of bodies.
+};
+
 struct options_t {
     char* input_filename;
     char* output_filename;
@@ -8,6 +48,30 @@ struct options_t {
     double dt;
     bool visualization;
     int records;
+    tree_build_t tree_build;
+    const char* simd;
+    int group_size;
+    int leaf_size;
+    int threads;
+    pin_t pin;
+    bool verify_tree;
+    bool distributed;
+    balance_t balance;
+    bool log_imbalance;
+    int chunks;
+    bool float_positions;
+    integrator_t integrator;
+    const char* checkpoint_prefix;
+    int checkpoint_every;
+    double checkpoint_seconds;
+    int snapshot_every;
+    const char* trajectory_filename;
+    const char* profile_filename;
+    double rebuild_threshold;
+    opening_t opening;
+    int multipole_order;
+    solver_t solver;
+    double tolerance;
 };
 
 void get_opts(int argc, char **argv, struct options_t *opts);
\ No newline at end of file
@@ -0,0 +1,1049 @@
+#include "bhtree.h"
+
+#include <math.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+// Custom Libraries
+#include "helpers.h"
+#include "morton.h"
+
+BHTree::BHTree(int input_leaf_size, double input_space_length, opening_t input_opening, int input_multipole_order) {
+    leaf_size = max(input_leaf_size, 1);
+    space_length = input_space_length;
+    opening = input_opening;
+    multipole_order = input_multipole_order;
+    bodies = nullptr;
+    nodes.emplace_back(0, space_length);
+    bytes_sent = 0;
+    bytes_received = 0;
+    moved_since_rebuild = 0;
+    rebuilt_bodies = 0;
+    rebuilt_nodes = 0;
+}
+
+void BHTree::reset(vector<body>& input_bodies) {
+    bodies = input_bodies.data();
+    next_body.resize(input_bodies.size());
+    body_leaf.resize(input_bodies.size());
+
+    // TreeNode is trivially destructible, so clearing only resets the pool's size and keeps its capacity.
+    nodes.clear();
+    nodes.emplace_back(0, space_length);
+}
+
+void BHTree::insertBody(int body_index) {
+    body& body = bodies[body_index];
+
+    // Lost bodies are not part of the simulation anymore.
+    if (body.mass == -1) {
+        return;
+    }
+
+    // Walk down from the root instead of recursing, splitting the leaf the body lands in when it is already full.  Centers of mass are left to calculateCenterOfMass().
+    int node_index = 0;
+    while (node_index != -1) {
+        if (nodes[node_index].isLeaf()) {
+            // Bodies that still share a leaf at the deepest level cannot be separated, so the leaf keeps all of them.
+            if (nodes[node_index].body_count < leaf_size || nodes[node_index].level >= MORTON_BITS) {
+                addLeafBody(node_index, body_index);
+                return;
+            }
+            subdivide(nodes, node_index);
+
+            // The bodies of the leaf that was just split move into the new (empty) children.
+            int moved_index = nodes[node_index].body_index;
+            nodes[node_index].body_index = -1;
+            nodes[node_index].last_body = -1;
+            nodes[node_index].body_count = 0;
+            while (moved_index != -1) {
+                int next_index = next_body[moved_index];
+                int child_index = selectChild(node_index, bodies[moved_index]);
+                if (child_index != -1) {
+                    addLeafBody(child_index, moved_index);
+                }
+                moved_index = next_index;
+            }
+        }
+        node_index = selectChild(node_index, body);
+    }
+}
+
+void BHTree::addLeafBody(int node_index, int body_index) {
+    TreeNode& node = nodes[node_index];
+    next_body[body_index] = -1;
+    if (node.last_body == -1) {
+        node.body_index = body_index;
+    } else {
+        next_body[node.last_body] = body_index;
+    }
+    node.last_body = body_index;
+    ++node.body_count;
+    body_leaf[body_index] = node_index;
+}
+
+void BHTree::removeLeafBody(int node_index, int body_index) {
+    TreeNode& node = nodes[node_index];
+    int* link = &node.body_index;
+    int previous_index = -1;
+    while (*link != body_index) {
+        previous_index = *link;
+        link = &next_body[*link];
+    }
+    *link = next_body[body_index];
+    if (node.last_body == body_index) {
+        node.last_body = previous_index;
+    }
+    --node.body_count;
+    body_leaf[body_index] = -1;
+}
+
+void BHTree::calculateCenterOfMass() {
+    int nodes_size = nodes.size();
+
+    // Leaves only read their own bodies, so several threads sum them up first in pool order.  A single thread sums them up during the sweep below, which then is the only pass over the pool.
+    bool leaves_summed = omp_get_max_threads() > 1;
+    if (leaves_summed) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < nodes_size; ++i) {
+            if (nodes[i].isLeaf()) {
+                sumLeaf(nodes, i);
+            }
+        }
+    }
+
+    // Children always come after their parent in the pool, so walking it backwards sums up every child before its parent.
+    subtree_bodies.resize(nodes_size);
+    for (int i = nodes_size - 1; i >= 0; --i) {
+        TreeNode& node = nodes[i];
+        if (node.isLeaf()) {
+            if (!leaves_summed) {
+                sumLeaf(nodes, i);
+            }
+            subtree_bodies[i] = node.body_count;
+            continue;
+        }
+
+        int first_child = node.first_child;
+        subtree_bodies[i] = subtree_bodies[first_child] + subtree_bodies[first_child + 1] + subtree_bodies[first_child + 2] + subtree_bodies[first_child + 3];
+        if (subtree_bodies[i] > leaf_size) {
+            sumChildren(nodes, i);
+            continue;
+        }
+
+        /*  A node that has no more than leaf_size bodies left becomes a leaf again, like a build would have left it,
+            so leaves do not keep shrinking to the closest two bodies ever came.  Its children, which are leaves by now,
+            hand over their bodies and stay in the pool unused until the next build.
+        */
+        node.first_child = -1;
+        for (int c = 0; c < 4; ++c) {
+            TreeNode& child = nodes[first_child + c];
+            int body_index = child.body_index;
+            while (body_index != -1) {
+                int next_index = next_body[body_index];
+                addLeafBody(i, body_index);
+                body_index = next_index;
+            }
+            child.body_index = -1;
+            child.last_body = -1;
+            child.body_count = 0;
+        }
+        sumLeaf(nodes, i);
+    }
+}
+
+void BHTree::sumLeaf(vector<TreeNode>& pool, int node_index) {
+    TreeNode& node = pool[node_index];
+    node.com_x_sum = 0;
+    node.com_y_sum = 0;
+    node.total_mass = 0;
+    node.radius = 0;
+    if (node.body_count == 0) {
+        return;
+    }
+
+    for (int body_index = node.body_index; body_index != -1; body_index = next_body[body_index]) {
+        node.com_x_sum += bodies[body_index].x_pos * bodies[body_index].mass;
+        node.com_y_sum += bodies[body_index].y_pos * bodies[body_index].mass;
+        node.total_mass += bodies[body_index].mass;
+    }
+    node.com_x = node.com_x_sum / node.total_mass;
+    node.com_y = node.com_y_sum / node.total_mass;
+
+    // Only the bmax criterion needs the radius, which costs square roots.
+    if (opening != OPENING_BMAX) {
+        return;
+    }
+
+    // Compared on squares, with a single square root for the farthest body.
+    double radius_sq = 0;
+    for (int body_index = node.body_index; body_index != -1; body_index = next_body[body_index]) {
+        double d_x = bodies[body_index].x_pos - node.com_x;
+        double d_y = bodies[body_index].y_pos - node.com_y;
+        radius_sq = max(radius_sq, (d_x * d_x) + (d_y * d_y));
+    }
+    node.radius = sqrt(radius_sq);
+}
+
+void BHTree::sumChildren(vector<TreeNode>& pool, int node_index) {
+    TreeNode& node = pool[node_index];
+    int first_child = node.first_child;
+    node.com_x_sum = 0;
+    node.com_y_sum = 0;
+    node.total_mass = 0;
+    for (int i = 0; i < 4; ++i) {
+        TreeNode& child = pool[first_child + i];
+        node.com_x_sum += child.com_x_sum;
+        node.com_y_sum += child.com_y_sum;
+        node.total_mass += child.total_mass;
+    }
+    node.com_x = node.com_x_sum / node.total_mass;
+    node.com_y = node.com_y_sum / node.total_mass;
+
+    if (opening != OPENING_BMAX) {
+        return;
+    }
+
+    // Every body of a child lies within the child's radius of the child's center of mass, and within the node's space.
+    double radius = 0;
+    for (int i = 0; i < 4; ++i) {
+        TreeNode& child = pool[first_child + i];
+        if (child.total_mass > 0) {
+            double d_x = child.com_x - node.com_x;
+            double d_y = child.com_y - node.com_y;
+            radius = max(radius, sqrt((d_x * d_x) + (d_y * d_y)) + child.radius);
+        }
+    }
+    double corner_x = max(node.com_x - node.x, node.x + node.space_length - node.com_x);
+    double corner_y = max(node.com_y - node.y, node.y + node.space_length - node.com_y);
+    node.radius = min(radius, sqrt((corner_x * corner_x) + (corner_y * corner_y)));
+}
+
+void BHTree::indexLeaves() {
+    int nodes_size = nodes.size();
+    fill(body_leaf.begin(), body_leaf.end(), -1);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < nodes_size; ++i) {
+        if (nodes[i].isLeaf()) {
+            for (int body_index = nodes[i].body_index; body_index != -1; body_index = next_body[body_index]) {
+                body_leaf[body_index] = i;
+            }
+        }
+    }
+}
+
+void BHTree::updateMorton(vector<body>& input_bodies, double rebuild_threshold) {
+    int bodies_size = input_bodies.size();
+    bool rebuild = bodies != input_bodies.data() || static_cast<int>(body_leaf.size()) != bodies_size || rebuilt_bodies == 0;
+
+    if (!rebuild) {
+        // A body stays in its leaf as long as it is still inside the leaf's space, bounds included like selectChild().
+        long moved_size = 0;
+        body_moved.resize(bodies_size);
+        #pragma omp parallel for schedule(static) reduction(+ : moved_size)
+        for (int i = 0; i < bodies_size; ++i) {
+            body& body = input_bodies[i];
+            body_moved[i] = false;
+            if (body_leaf[i] == -1) {
+                continue;
+            }
+            TreeNode& leaf = nodes[body_leaf[i]];
+            body_moved[i] = body.mass == -1 || body.x_pos < leaf.x || body.x_pos > leaf.x + leaf.space_length || body.y_pos < leaf.y || body.y_pos > leaf.y + leaf.space_length;
+            moved_size += body_moved[i];
+        }
+        moved_since_rebuild += moved_size;
+        // Nodes split off for moved bodies are never reused, so a pool that has doubled is rebuilt as well.
+        rebuild = moved_since_rebuild > rebuild_threshold * rebuilt_bodies || nodes.size() > 2 * rebuilt_nodes;
+    }
+
+    if (rebuild) {
+        buildMorton(input_bodies);
+        indexLeaves();
+        moved_since_rebuild = 0;
+        rebuilt_bodies = lower_bound(keys.begin(), keys.end(), LOST_MORTON_KEY) - keys.begin();
+        rebuilt_nodes = nodes.size();
+        return;
+    }
+
+    // Lost bodies only leave the tree.
+    moved_bodies.clear();
+    for (int i = 0; i < bodies_size; ++i) {
+        if (body_moved[i]) {
+            moved_bodies.push_back(i);
+        }
+    }
+    for (int body_index : moved_bodies) {
+        removeLeafBody(body_leaf[body_index], body_index);
+    }
+    for (int body_index : moved_bodies) {
+        insertBody(body_index);
+    }
+
+    calculateCenterOfMass();
+}
+
+void BHTree::buildMorton(vector<body>& input_bodies, bool parallel) {
+    int bodies_end = sortMorton(input_bodies);
+    if (parallel && omp_get_max_threads() > 1) {
+        buildMortonParallel(bodies_end);
+    } else {
+        buildMortonNode(nodes, 0, 0, bodies_end);
+    }
+}
+
+int BHTree::sortMorton(vector<body>& input_bodies) {
+    int bodies_size = input_bodies.size();
+
+    keys.resize(bodies_size);
+    order.resize(bodies_size);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < bodies_size; ++i) {
+        body& body = input_bodies[i];
+        keys[i] = (body.mass == -1) ? LOST_MORTON_KEY : calculateMortonKey(body.x_pos, body.y_pos, space_length);
+        order[i] = i;
+    }
+
+    radixSortKeys(keys, order, keys_buffer, order_buffer);
+
+    // Reorder the bodies along the Z-curve.
+    bodies_buffer.resize(bodies_size);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < bodies_size; ++i) {
+        bodies_buffer[i] = input_bodies[order[i]];
+    }
+    input_bodies.swap(bodies_buffer);
+
+    reset(input_bodies);
+
+    return lower_bound(keys.begin(), keys.end(), LOST_MORTON_KEY) - keys.begin();
+}
+
+int BHTree::getSplitLevel(int workers) {
+    // Split deep enough to have several subtrees per worker for the dynamic schedule to balance.
+    int split_level = 1;
+    while ((1 << (2 * split_level)) < 8 * workers && split_level < 6) {
+        ++split_level;
+    }
+    return split_level;
+}
+
+int BHTree::findQuadrantEnd(int begin, int end, int level, int quadrant) {
+    return partition_point(keys.begin() + begin, keys.begin() + end, [&](uint64_t key) {
+               return getMortonQuadrant(key, level) <= quadrant;
+           }) - keys.begin();
+}
+
+void BHTree::buildMortonNode(vector<TreeNode>& pool, int node_index, int begin, int end) {
+    int level = pool[node_index].level;
+
+    if (end - begin == 0) {
+        return;
+    }
+
+    // Bodies that still share a cell at the deepest Morton level cannot be separated, so the leaf keeps all of them.
+    if (end - begin <= leaf_size || level == MORTON_BITS) {
+        TreeNode& node = pool[node_index];
+        node.body_index = begin;
+        node.last_body = end - 1;
+        node.body_count = end - begin;
+        for (int i = begin; i < end; ++i) {
+            next_body[i] = (i + 1 < end) ? i + 1 : -1;
+        }
+        sumLeaf(pool, node_index);
+        return;
+    }
+
+    subdivide(pool, node_index);
+    int first_child = pool[node_index].first_child;
+
+    // The keys are sorted, so the children's ranges follow each other in SW, SE, NW, NE order.
+    int child_begin = begin;
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        int child_end = findQuadrantEnd(child_begin, end, level + 1, quadrant);
+
+        // Quadrant codes map to the NW, NE, SW, SE child order by flipping the y bit.
+        buildMortonNode(pool, first_child + (quadrant ^ 2), child_begin, child_end);
+        child_begin = child_end;
+    }
+
+    sumChildren(pool, node_index);
+}
+
+void BHTree::buildMortonParallel(int bodies_end) {
+    int split_level = getSplitLevel(omp_get_max_threads());
+
+    morton_tasks.clear();
+    buildMortonTop(0, 0, bodies_end, split_level);
+
+    int tasks_size = morton_tasks.size();
+    if (static_cast<int>(task_nodes.size()) < tasks_size) {
+        task_nodes.resize(tasks_size);
+    }
+
+    // Every subtree is built in its own pool, starting from a copy of its root.  The subtrees' bodies and next_body entries do not overlap.
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < tasks_size; ++t) {
+        MortonTask& task = morton_tasks[t];
+        vector<TreeNode>& pool = task_nodes[t];
+        pool.clear();
+        pool.push_back(nodes[task.node_index]);
+        buildMortonNode(pool, 0, task.begin, task.end);
+    }
+
+    // Append the subtrees to the node pool.  A subtree's root replaces its placeholder and the rest of its nodes move by the subtree's offset.
+    vector<int> offsets(tasks_size);
+    int nodes_size = nodes.size();
+    for (int t = 0; t < tasks_size; ++t) {
+        offsets[t] = nodes_size - 1;
+        nodes_size += task_nodes[t].size() - 1;
+    }
+    nodes.resize(nodes_size);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = 0; t < tasks_size; ++t) {
+        vector<TreeNode>& pool = task_nodes[t];
+        int pool_size = pool.size();
+        for (int i = 0; i < pool_size; ++i) {
+            TreeNode node = pool[i];
+            if (!node.isLeaf()) {
+                node.first_child += offsets[t];
+            }
+            nodes[(i == 0) ? morton_tasks[t].node_index : offsets[t] + i] = node;
+        }
+    }
+
+    sumCenterOfMassTop(0, split_level);
+}
+
+void BHTree::buildMortonShared(vector<body>& input_bodies, MPI_Comm comm) {
+    int comm_size, comm_rank;
+    MPI_Comm_size(comm, &comm_size);
+    MPI_Comm_rank(comm, &comm_rank);
+
+    int bodies_end = sortMorton(input_bodies);
+    int split_level = getSplitLevel(comm_size * omp_get_max_threads());
+
+    // Every process subdivides the same top levels into the same subtrees.
+    morton_tasks.clear();
+    buildMortonTop(0, 0, bodies_end, split_level);
+    int tasks_size = morton_tasks.size();
+
+    // Process p builds the subtrees in [first_tasks[p], first_tasks[p + 1]), the ones starting in its share of the bodies.
+    vector<int> first_tasks(comm_size + 1);
+    for (int p = 0; p <= comm_size; ++p) {
+        long share_begin = static_cast<long>(bodies_end) * p / comm_size;
+        first_tasks[p] = partition_point(morton_tasks.begin(), morton_tasks.end(), [share_begin](MortonTask& task) {
+                             return task.begin < share_begin;
+                         }) - morton_tasks.begin();
+    }
+    int task_begin = first_tasks[comm_rank];
+    int task_end = first_tasks[comm_rank + 1];
+
+    if (static_cast<int>(task_nodes.size()) < tasks_size) {
+        task_nodes.resize(tasks_size);
+    }
+    if (static_cast<int>(task_flat_nodes.size()) < tasks_size) {
+        task_flat_nodes.resize(tasks_size);
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int t = task_begin; t < task_end; ++t) {
+        MortonTask& task = morton_tasks[t];
+        vector<TreeNode>& pool = task_nodes[t];
+        pool.clear();
+        pool.push_back(nodes[task.node_index]);
+        buildMortonNode(pool, 0, task.begin, task.end);
+
+        task_flat_nodes[t].clear();
+        flattenTask(pool, 0, task_flat_nodes[t]);
+    }
+
+    // The number of flat nodes, the sums and the radius of the root of every subtree.  A process only fills in its own subtrees, so summing them up gathers them exactly.
+    task_summaries.assign(TASK_SUMMARY_SIZE * tasks_size, 0);
+    for (int t = task_begin; t < task_end; ++t) {
+        TreeNode& root = task_nodes[t][0];
+        double* summary = &task_summaries[TASK_SUMMARY_SIZE * t];
+        summary[0] = task_flat_nodes[t].size();
+        summary[1] = root.com_x_sum;
+        summary[2] = root.com_y_sum;
+        summary[3] = root.total_mass;
+        summary[4] = root.radius;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, task_summaries.data(), TASK_SUMMARY_SIZE * tasks_size, MPI_DOUBLE, MPI_SUM, comm);
+
+    task_flat_begin.resize(tasks_size + 1);
+    task_flat_begin[0] = 0;
+    for (int t = 0; t < tasks_size; ++t) {
+        task_flat_begin[t + 1] = task_flat_begin[t] + static_cast<int>(task_summaries[TASK_SUMMARY_SIZE * t]);
+    }
+
+    // The processes' subtrees follow each other in subtree order, so every process's flat nodes are one block.
+    vector<int> counts(comm_size), displacements(comm_size);
+    for (int p = 0; p < comm_size; ++p) {
+        displacements[p] = task_flat_begin[first_tasks[p]];
+        counts[p] = task_flat_begin[first_tasks[p + 1]] - displacements[p];
+    }
+    shared_flat_nodes.resize(task_flat_begin[tasks_size]);
+    for (int t = task_begin; t < task_end; ++t) {
+        copy(task_flat_nodes[t].begin(), task_flat_nodes[t].end(), shared_flat_nodes.begin() + task_flat_begin[t]);
+    }
+
+    MPI_Datatype flat_node_dt;
+    MPI_Type_contiguous(sizeof(FlatNode), MPI_BYTE, &flat_node_dt);
+    MPI_Type_commit(&flat_node_dt);
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, shared_flat_nodes.data(), counts.data(), displacements.data(), flat_node_dt, comm);
+    MPI_Type_free(&flat_node_dt);
+
+    bytes_sent += static_cast<double>(counts[comm_rank]) * sizeof(FlatNode) * (comm_size - 1);
+    bytes_received += static_cast<double>(shared_flat_nodes.size() - counts[comm_rank]) * sizeof(FlatNode);
+
+    // The subtrees' roots are leaves of the top levels, so their sums and radii are all the top levels need.
+    node_tasks.assign(nodes.size(), -1);
+    for (int t = 0; t < tasks_size; ++t) {
+        TreeNode& root = nodes[morton_tasks[t].node_index];
+        double* summary = &task_summaries[TASK_SUMMARY_SIZE * t];
+        root.com_x_sum = summary[1];
+        root.com_y_sum = summary[2];
+        root.total_mass = summary[3];
+        root.com_x = root.com_x_sum / root.total_mass;
+        root.com_y = root.com_y_sum / root.total_mass;
+        root.radius = summary[4];
+        node_tasks[morton_tasks[t].node_index] = t;
+    }
+    sumCenterOfMassTop(0, split_level);
+
+    flat_nodes.clear();
+    flat_x_pos.clear();
+    flat_y_pos.clear();
+    flat_mass.clear();
+    flat_body_index.clear();
+    flattenShared(0);
+
+    if (multipole_order >= 2) {
+        calculateMoments();
+    }
+}
+
+void BHTree::getTraffic(double* sent, double* received) {
+    *sent = bytes_sent;
+    *received = bytes_received;
+    bytes_sent = 0;
+    bytes_received = 0;
+}
+
+void BHTree::buildMortonTop(int node_index, int begin, int end, int split_level) {
+    int level = nodes[node_index].level;
+
+    if (end - begin == 0) {
+        return;
+    }
+
+    if (level == split_level || end - begin <= leaf_size || level == MORTON_BITS) {
+        morton_tasks.push_back({node_index, begin, end});
+        return;
+    }
+
+    subdivide(nodes, node_index);
+    int first_child = nodes[node_index].first_child;
+
+    int child_begin = begin;
+    for (int quadrant = 0; quadrant < 4; ++quadrant) {
+        int child_end = findQuadrantEnd(child_begin, end, level + 1, quadrant);
+        buildMortonTop(first_child + (quadrant ^ 2), child_begin, child_end, split_level);
+        child_begin = child_end;
+    }
+}
+
+void BHTree::sumCenterOfMassTop(int node_index, int split_level) {
+    // Leaves and subtrees built by the threads already have their center of mass.
+    if (nodes[node_index].isLeaf() || nodes[node_index].level >= split_level) {
+        return;
+    }
+
+    int first_child = nodes[node_index].first_child;
+    for (int i = 0; i < 4; ++i) {
+        sumCenterOfMassTop(first_child + i, split_level);
+    }
+
+    // Summed the same way as buildMortonNode() so the result is bit for bit the same.
+    sumChildren(nodes, node_index);
+}
+
+void BHTree::subdivide(vector<TreeNode>& pool, int node_index) {
+    int level = pool[node_index].level + 1;
+    double x = pool[node_index].x;
+    double y = pool[node_index].y;
+    double new_space_length = pool[node_index].space_length / 2;
+
+    pool[node_index].first_child = static_cast<int>(pool.size());
+    pool.emplace_back(level, new_space_length, x, y + new_space_length);                     // index 0 - NW
+    pool.emplace_back(level, new_space_length, x + new_space_length, y + new_space_length);  // index 1 - NE
+    pool.emplace_back(level, new_space_length, x, y);                                        // index 2 - SW
+    pool.emplace_back(level, new_space_length, x + new_space_length, y);                     // index 3 - SE
+}
+
+int BHTree::selectChild(int node_index, body& body) {
+    TreeNode& node = nodes[node_index];
+
+    if (body.x_pos < node.x || body.x_pos > node.x + node.space_length || body.y_pos < node.y || body.y_pos > node.y + node.space_length) {
+        return -1;
+    }
+
+    // Children bounds are inclusive and checked in NW, NE, SW, SE order, so a body on a dividing line goes to the west and north side.
+    double half_space_length = node.space_length / 2;
+    bool west = body.x_pos <= node.x + half_space_length;
+    bool north = body.y_pos >= node.y + half_space_length;
+
+    if (north) {
+        return node.first_child + (west ? 0 : 1);
+    }
+    return node.first_child + (west ? 2 : 3);
+}
+
+double BHTree::getOpeningSizeSq(TreeNode& node) {
+    double size = (opening == OPENING_BMAX) ? node.radius : node.space_length;
+    return size * size;
+}
+
+void BHTree::flatten() {
+    flat_nodes.clear();
+    flat_x_pos.clear();
+    flat_y_pos.clear();
+    flat_mass.clear();
+    flat_body_index.clear();
+    flattenNode(0);
+
+    if (multipole_order >= 2) {
+        calculateMoments();
+    }
+}
+
+void BHTree::calculateMoments() {
+    int flat_nodes_size = flat_nodes.size();
+    flat_moments.resize(3 * flat_nodes_size);
+
+    // Children follow their parent in the flattened tree, so walking it backwards sums up every child before its parent.
+    for (int i = flat_nodes_size - 1; i >= 0; --i) {
+        FlatNode& node = flat_nodes[i];
+        double* moments = &flat_moments[3 * i];
+        moments[0] = 0;
+        moments[1] = 0;
+        moments[2] = 0;
+
+        // Every body, or child, at d from the center of mass adds m (3 d d^T - |d|^2 I), a child its own moments as well.
+        if (node.body_count > 0) {
+            for (int j = node.body_begin; j < node.body_begin + node.body_count; ++j) {
+                double d_x = flat_x_pos[j] - node.com_x;
+                double d_y = flat_y_pos[j] - node.com_y;
+                moments[0] += flat_mass[j] * ((2 * d_x * d_x) - (d_y * d_y));
+                moments[1] += flat_mass[j] * (3 * d_x * d_y);
+                moments[2] += flat_mass[j] * ((2 * d_y * d_y) - (d_x * d_x));
+            }
+            continue;
+        }
+
+        for (int child = i + 1; child < node.next; child = flat_nodes[child].next) {
+            FlatNode& child_node = flat_nodes[child];
+            double* child_moments = &flat_moments[3 * child];
+            double d_x = child_node.com_x - node.com_x;
+            double d_y = child_node.com_y - node.com_y;
+            moments[0] += child_moments[0] + (child_node.mass * ((2 * d_x * d_x) - (d_y * d_y)));
+            moments[1] += child_moments[1] + (child_node.mass * (3 * d_x * d_y));
+            moments[2] += child_moments[2] + (child_node.mass * ((2 * d_y * d_y) - (d_x * d_x)));
+        }
+    }
+}
+
+void BHTree::flattenNode(int node_index) {
+    TreeNode& node = nodes[node_index];
+
+    if (node.isLeaf()) {
+        if (node.body_count == 0) {
+            return;
+        }
+
+        int flat_index = flat_nodes.size();
+        int body_begin = flat_x_pos.size();
+        double com_x_sum = 0, com_y_sum = 0, total_mass = 0;
+        for (int body_index = node.body_index; body_index != -1; body_index = next_body[body_index]) {
+            body& body = bodies[body_index];
+            flat_x_pos.push_back(body.x_pos);
+            flat_y_pos.push_back(body.y_pos);
+            flat_mass.push_back(body.mass);
+            flat_body_index.push_back(body_index);
+            com_x_sum += body.x_pos * body.mass;
+            com_y_sum += body.y_pos * body.mass;
+            total_mass += body.mass;
+        }
+
+        // A single body is used at its exact position.
+        if (node.body_count == 1) {
+            flat_nodes.push_back({flat_x_pos[body_begin], flat_y_pos[body_begin], total_mass, getOpeningSizeSq(node), flat_index + 1, body_begin, 1});
+        } else {
+            flat_nodes.push_back({com_x_sum / total_mass, com_y_sum / total_mass, total_mass, getOpeningSizeSq(node), flat_index + 1, body_begin, node.body_count});
+        }
+        return;
+    }
+
+    int flat_index = flat_nodes.size();
+    flat_nodes.push_back({node.com_x, node.com_y, node.total_mass, getOpeningSizeSq(node), -1, 0, 0});
+
+    int first_child = node.first_child;
+    for (int i = 0; i < 4; ++i) {
+        flattenNode(first_child + i);
+    }
+
+    flat_nodes[flat_index].next = flat_nodes.size();
+}
+
+void BHTree::flattenTask(vector<TreeNode>& pool, int node_index, vector<FlatNode>& task_flat) {
+    TreeNode& node = pool[node_index];
+    int flat_index = task_flat.size();
+
+    // The same nodes as flattenNode(): a leaf's center of mass is summed in the same order by buildMortonNode().
+    if (node.isLeaf()) {
+        if (node.body_count == 1) {
+            task_flat.push_back({bodies[node.body_index].x_pos, bodies[node.body_index].y_pos, node.total_mass, getOpeningSizeSq(node), flat_index + 1, node.body_index, 1});
+        } else if (node.body_count > 1) {
+            task_flat.push_back({node.com_x, node.com_y, node.total_mass, getOpeningSizeSq(node), flat_index + 1, node.body_index, node.body_count});
+        }
+        return;
+    }
+
+    task_flat.push_back({node.com_x, node.com_y, node.total_mass, getOpeningSizeSq(node), -1, 0, 0});
+
+    int first_child = node.first_child;
+    for (int i = 0; i < 4; ++i) {
+        flattenTask(pool, first_child + i, task_flat);
+    }
+
+    task_flat[flat_index].next = task_flat.size();
+}
+
+void BHTree::flattenShared(int node_index) {
+    int task = node_tasks[node_index];
+    if (task != -1) {
+        // Move the subtree to its place in the flattened tree and copy its leaves' bodies, which every process has, in the order flattenNode() would.
+        int offset = flat_nodes.size();
+        for (int i = task_flat_begin[task]; i < task_flat_begin[task + 1]; ++i) {
+            FlatNode node = shared_flat_nodes[i];
+            node.next += offset;
+            if (node.body_count > 0) {
+                int body_begin = flat_x_pos.size();
+                for (int j = node.body_begin; j < node.body_begin + node.body_count; ++j) {
+                    flat_x_pos.push_back(bodies[j].x_pos);
+                    flat_y_pos.push_back(bodies[j].y_pos);
+                    flat_mass.push_back(bodies[j].mass);
+                    flat_body_index.push_back(j);
+                }
+                node.body_begin = body_begin;
+            }
+            flat_nodes.push_back(node);
+        }
+        return;
+    }
+
+    // Top leaves without a subtree are empty.
+    TreeNode& node = nodes[node_index];
+    if (node.isLeaf()) {
+        return;
+    }
+
+    int flat_index = flat_nodes.size();
+    flat_nodes.push_back({node.com_x, node.com_y, node.total_mass, getOpeningSizeSq(node), -1, 0, 0});
+
+    int first_child = node.first_child;
+    for (int i = 0; i < 4; ++i) {
+        flattenShared(first_child + i);
+    }
+
+    flat_nodes[flat_index].next = flat_nodes.size();
+}
+
+int BHTree::calculateNetForce(ParticleStore& particles, int particle_index, double theta, InteractionList& interactions) {
+    double x = particles.x_pos[particle_index];
+    double y = particles.y_pos[particle_index];
+    double mass = particles.mass[particle_index];
+
+    particles.F_x[particle_index] = 0;
+    particles.F_y[particle_index] = 0;
+    particles.cost[particle_index] = 0;
+
+    // Lost bodies do not move anymore, so they do not need a net force.
+    if (mass == -1) {
+        return 0;
+    }
+
+    double theta_sq = theta * theta;
+    double rlimit_sq = rlimit * rlimit;
+    bool quadrupoles = multipole_order >= 2;
+
+    interactions.clear();
+
+    int flat_nodes_size = flat_nodes.size();
+    int node_index = 0;
+    int visits = 0;
+    while (node_index < flat_nodes_size) {
+        FlatNode& node = flat_nodes[node_index];
+        ++visits;
+
+        // A leaf with a single body is always used as is.  The body itself may be one of them, it does not add any force.
+        if (node.body_count != 1) {
+            double d_x = node.com_x - x;
+            double d_y = node.com_y - y;
+            double distance_sq = (d_x * d_x) + (d_y * d_y);
+
+            // s / d < theta, with s the node's size and d clamped to rlimit, compared on squares so opened nodes never pay for a square root.
+            if (node.size_sq >= theta_sq * max(distance_sq, rlimit_sq)) {
+                if (node.body_count == 0) {
+                    ++node_index;
+                } else {
+                    interactions.append(&flat_x_pos[node.body_begin], &flat_y_pos[node.body_begin], &flat_mass[node.body_begin], node.body_count);
+                    node_index = node.next;
+                }
+                continue;
+            }
+        }
+
+        interactions.add(node.com_x, node.com_y, node.mass);
+        if (quadrupoles && node.body_count != 1) {
+            interactions.addQuadrupole(node.com_x, node.com_y, &flat_moments[3 * node_index]);
+        }
+        node_index = node.next;
+    }
+
+    double F_x = 0;
+    double F_y = 0;
+    accumulateForce(x, y, interactions, &F_x, &F_y);
+
+    particles.cost[particle_index] = interactions.size();
+    particles.F_x[particle_index] = G * mass * F_x;
+    particles.F_y[particle_index] = G * mass * F_y;
+
+    return visits;
+}
+
+int BHTree::calculateNetForceGroup(ParticleStore& particles, int begin, int end, double theta, InteractionList& interactions) {
+    // Bounding box of the group's particles that are still in the simulation.
+    double min_x = 4, min_y = 4, max_x = 0, max_y = 0;
+    bool has_particles = false;
+    for (int i = begin; i < end; ++i) {
+        particles.F_x[i] = 0;
+        particles.F_y[i] = 0;
+        particles.cost[i] = 0;
+        if (particles.mass[i] != -1) {
+            min_x = min(min_x, particles.x_pos[i]);
+            max_x = max(max_x, particles.x_pos[i]);
+            min_y = min(min_y, particles.y_pos[i]);
+            max_y = max(max_y, particles.y_pos[i]);
+            has_particles = true;
+        }
+    }
+
+    if (!has_particles) {
+        return 0;
+    }
+
+    double theta_sq = theta * theta;
+    double rlimit_sq = rlimit * rlimit;
+    bool quadrupoles = multipole_order >= 2;
+
+    interactions.clear();
+
+    int flat_nodes_size = flat_nodes.size();
+    int node_index = 0;
+    int visits = 0;
+    while (node_index < flat_nodes_size) {
+        FlatNode& node = flat_nodes[node_index];
+        ++visits;
+
+        // The group's own bodies stay in the list, a body at the target's position does not add any force.
+        if (node.body_count != 1) {
+            // Distance from the center of mass to the closest point of the bounding box.
+            double d_x = max(max(min_x - node.com_x, node.com_x - max_x), 0.0);
+            double d_y = max(max(min_y - node.com_y, node.com_y - max_y), 0.0);
+            double distance_sq = (d_x * d_x) + (d_y * d_y);
+
+            if (node.size_sq >= theta_sq * max(distance_sq, rlimit_sq)) {
+                if (node.body_count == 0) {
+                    ++node_index;
+                } else {
+                    interactions.append(&flat_x_pos[node.body_begin], &flat_y_pos[node.body_begin], &flat_mass[node.body_begin], node.body_count);
+                    node_index = node.next;
+                }
+                continue;
+            }
+        }
+
+        interactions.add(node.com_x, node.com_y, node.mass);
+        if (quadrupoles && node.body_count != 1) {
+            interactions.addQuadrupole(node.com_x, node.com_y, &flat_moments[3 * node_index]);
+        }
+        node_index = node.next;
+    }
+
+    for (int i = begin; i < end; ++i) {
+        if (particles.mass[i] == -1) {
+            continue;
+        }
+
+        double F_x = 0;
+        double F_y = 0;
+        accumulateForce(particles.x_pos[i], particles.y_pos[i], interactions, &F_x, &F_y);
+
+        particles.cost[i] = interactions.size();
+        particles.F_x[i] = G * particles.mass[i] * F_x;
+        particles.F_y[i] = G * particles.mass[i] * F_y;
+    }
+
+    return visits;
+}
+
+long BHTree::calculateNetForces(ParticleStore& particles, int begin, int end, double theta, int group_size, IntegrationStep* step) {
+    thread_interactions.resize(omp_get_max_threads());
+    long visits = 0;
+
+    // Bodies in dense regions cost far more than isolated ones, so work is handed out dynamically in small chunks.
+    if (group_size <= 1) {
+        #pragma omp parallel for schedule(dynamic, 64) reduction(+ : visits)
+        for (int i = begin; i < end; ++i) {
+            visits += calculateNetForce(particles, i, theta, thread_interactions[omp_get_thread_num()]);
+            if (step != nullptr) {
+                particles.integrate(i, *step);
+            }
+        }
+        return visits;
+    }
+
+    int groups = (end - begin + group_size - 1) / group_size;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+ : visits)
+    for (int group = 0; group < groups; ++group) {
+        int group_begin = begin + group * group_size;
+        int group_end = min(group_begin + group_size, end);
+        visits += calculateNetForceGroup(particles, group_begin, group_end, theta, thread_interactions[omp_get_thread_num()]);
+        if (step != nullptr) {
+            for (int i = group_begin; i < group_end; ++i) {
+                particles.integrate(i, *step);
+            }
+        }
+    }
+
+    return visits;
+}
+
+void BHTree::collectEssentialSources(double min_x, double min_y, double max_x, double max_y, double theta, vector<double>& sources) {
+    double theta_sq = theta * theta;
+    double rlimit_sq = rlimit * rlimit;
+
+    int flat_nodes_size = flat_nodes.size();
+    int node_index = 0;
+    while (node_index < flat_nodes_size) {
+        FlatNode& node = flat_nodes[node_index];
+
+        if (node.body_count != 1) {
+            double d_x = max(max(min_x - node.com_x, node.com_x - max_x), 0.0);
+            double d_y = max(max(min_y - node.com_y, node.com_y - max_y), 0.0);
+            double distance_sq = (d_x * d_x) + (d_y * d_y);
+
+            if (node.size_sq >= theta_sq * max(distance_sq, rlimit_sq)) {
+                if (node.body_count == 0) {
+                    ++node_index;
+                } else {
+                    for (int i = node.body_begin; i < node.body_begin + node.body_count; ++i) {
+                        sources.push_back(flat_x_pos[i]);
+                        sources.push_back(flat_y_pos[i]);
+                        sources.push_back(flat_mass[i]);
+                    }
+                    node_index = node.next;
+                }
+                continue;
+            }
+        }
+
+        sources.push_back(node.com_x);
+        sources.push_back(node.com_y);
+        sources.push_back(node.mass);
+        node_index = node.next;
+    }
+}
+
+bool BHTree::isEquivalent(BHTree& other) {
+    if (flat_nodes.size() != other.flat_nodes.size() || flat_x_pos.size() != other.flat_x_pos.size()) {
+        return false;
+    }
+
+    int flat_nodes_size = flat_nodes.size();
+    for (int i = 0; i < flat_nodes_size; ++i) {
+        FlatNode& node = flat_nodes[i];
+        FlatNode& other_node = other.flat_nodes[i];
+        if (node.com_x != other_node.com_x || node.com_y != other_node.com_y || node.mass != other_node.mass || node.size_sq != other_node.size_sq || node.next != other_node.next || node.body_begin != other_node.body_begin || node.body_count != other_node.body_count) {
+            return false;
+        }
+    }
+
+    return flat_x_pos == other.flat_x_pos && flat_y_pos == other.flat_y_pos && flat_mass == other.flat_mass && flat_body_index == other.flat_body_index && flat_moments == other.flat_moments;
+}
+
+vector<FlatNode>& BHTree::getFlatNodes() {
+    return flat_nodes;
+}
+
+vector<double>& BHTree::getFlatXPos() {
+    return flat_x_pos;
+}
+
+vector<double>& BHTree::getFlatYPos() {
+    return flat_y_pos;
+}
+
+vector<double>& BHTree::getFlatMass() {
+    return flat_mass;
+}
+
+vector<int>& BHTree::getFlatBodyIndex() {
+    return flat_body_index;
+}
+
+int BHTree::getRoot() {
+    return 0;
+}
+
+TreeNode& BHTree::getNode(int node_index) {
+    return nodes[node_index];
+}
+
+int BHTree::getNodeCount() {
+    return static_cast<int>(nodes.size());
+}
+
+void BHTree::printTree() {
+    printTree(0);
+}
+
+void BHTree::printTree(int node_index) {
+    TreeNode& node = nodes[node_index];
+    if (!node.isLeaf()) {
+        string bread_crumb = "|-";
+        printf("Node Space level(%d), x(%.8f), y(%.8f), space_length(%f), leaf(%s): Center of Mass - com_x(%.8f), com_y(%.8f), total_mass(%.8f) \n", node.level, node.x, node.y, node.space_length, "false", node.com_x, node.com_y, node.total_mass);
+        for (int i = 0; i < node.level; ++i) {
+            bread_crumb.append("-");
+        }
+        for (int i = 0; i < 4; ++i) {
+            printf("%schild %d ", bread_crumb.c_str(), i);
+            printTree(node.first_child + i);
+        }
+    } else {
+        if (node.body_index != -1) {
+            for (int body_index = node.body_index; body_index != -1; body_index = next_body[body_index]) {
+                printf("Node Space level(%d), x(%.8f), y(%.8f), space_length(%f), leaf(%s): ", node.level, node.x, node.y, node.space_length, "true");
+                bodies[body_index].printBody();
+            }
+        } else {
+            printf("Node Space level(%d), Empty Leaf \n", node.level);
+        }
+    }
+}
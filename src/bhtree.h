@@ -0,0 +1,276 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <cstdint>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+#include "kernels.h"
+#include "particles.h"
+#include "treenode.h"
+
+using namespace std;
+
+/*  A node of the flattened Barnes-Hut Tree.  Flattened nodes are laid out in depth-first order, so the first child
+    of an internal node is always the node right after it and next skips over the node's whole subtree.  Leaves keep
+    a copy of their bodies' positions and masses in the tree's flat body arrays so the force traversal never has to
+    look the bodies up.
+*/
+struct FlatNode {
+    double com_x, com_y;  // Center of Mass (com), or the body's position for a leaf with a single body.
+    double mass;  // Total mass of the node.
+    double size_sq;  // Squared size of the node, its space length or its radius, compared against theta without a square root.
+    int next;  // Index of the next node once this node's subtree is done with.
+    int body_begin;  // Index of the leaf's first body in the flat body arrays.
+    int body_count;  // Number of bodies in the leaf.  0 for internal nodes.
+};
+
+/*  Barnes-Hut Tree stored as a contiguous pool of TreeNodes.  The pool is reused from step to step: reset() drops
+    every node in O(1) but keeps the pool's capacity, so after the first step building the tree does not allocate.
+    Node 0 is always the root and covers the 0 to 4 coordinate space.
+*/
+class BHTree {
+   public:
+    /* Public Functions */
+    /*  Creates an empty Barnes-Hut Tree whose leaves hold up to input_leaf_size bodies, covering a space of
+        input_space_length on both axes.  input_opening selects the size of a node that is compared against theta.
+        With an input_multipole_order of 2, nodes accepted as a whole add their quadrupole moments to the force of
+        their center of mass.  Lower orders use the center of mass alone, its dipole moment is always zero.
+    */
+    BHTree(int input_leaf_size = 1, double input_space_length = 4, opening_t input_opening = OPENING_SIZE, int input_multipole_order = 0);
+
+    // Empties the tree and points it at the bodies that will be inserted for the next step.
+    void reset(vector<body>& bodies);
+
+    /*  Inserts the body at body_index of the bodies vector passed to reset() into the tree.  A leaf is split once it
+        would hold more than leaf_size bodies.  Only the structure of the tree changes, calculateCenterOfMass() must be
+        called once all bodies are in.
+    */
+    void insertBody(int body_index);
+
+    /*  Sums up the center of mass, and the radius if it is used, of every node from the bodies in its leaves.  The
+        process's threads sum up the leaves, then a single backward sweep over the node pool sums up every internal
+        node from its children.  With a single thread the leaves are summed up in the same sweep.  Internal nodes left
+        with at most leaf_size bodies become leaves again.
+    */
+    void calculateCenterOfMass();
+
+    /*  Builds the tree in bulk from the Morton keys of the bodies instead of inserting them one at a time.  The
+        bodies vector is radix sorted along the Z-curve in place, so bodies close in space are also close in memory,
+        and every node is then built from the contiguous range of bodies whose keys share the node's prefix.  A range of
+        at most leaf_size bodies becomes a leaf.  Lost bodies are sorted to the end of the vector and left out of the tree.
+        With parallel set and more than one thread, the subtrees below the top levels are built by the threads at the
+        same time.  The tree is the same as the one built by a single thread.
+    */
+    void buildMorton(vector<body>& bodies, bool parallel = true);
+
+    /*  Builds and flattens the tree like buildMorton() and flatten(), sharing the work between the processes of comm,
+        which all pass the same bodies.  Every process sorts the bodies and subdivides the top levels, but builds and
+        flattens only its own run of the subtrees below them, holding about its share of the bodies.  The flattened
+        subtrees and the centers of mass of their roots are then exchanged, and every process sums up the top levels
+        and lays out the same flattened tree flatten() would.  The node pool only holds the top levels afterwards, so
+        flatten() must not be called.
+    */
+    void buildMortonShared(vector<body>& bodies, MPI_Comm comm);
+
+    /*  Keeps the tree of the last step for bodies that moved a little, instead of building it from scratch.  Only
+        the bodies that left the space of their leaf, or the simulation, are taken out of it and placed again from the
+        root, and the centers of mass are then summed up again with calculateCenterOfMass().  Once the bodies moved
+        since the last rebuild exceed rebuild_threshold of the bodies in the tree, or bodies is not the vector of the
+        last step, the tree is rebuilt with buildMorton() instead, which also sorts the bodies again.  Between rebuilds
+        the bodies keep their order.
+    */
+    void updateMorton(vector<body>& bodies, double rebuild_threshold);
+
+    // Returns the bytes buildMortonShared() sent to and received from other processes since the last call.
+    void getTraffic(double* sent, double* received);
+
+    // Lays the tree out as an array of FlatNodes for calculateNetForce(), with their moments for a multipole order of 2.  Must be called after every build.
+    void flatten();
+
+    // True if both flattened trees have the same nodes, centers of mass, leaf bodies and their particle indices, bit for bit.
+    bool isEquivalent(BHTree& other);
+
+    /*  Calculate the net force onto a body using the following calculations:
+        Fx = G*M0*M1*dx / d^3
+        Fy = G*M0*M1*dy / d^3
+        onto the particle at particle_index.  The flattened tree is walked with a single loop: a node that is far
+        enough away is used as a whole and skipped with its next index, otherwise the traversal just moves on to the
+        following node, which is its first child.  An opened leaf adds all of its bodies, which are summed directly.
+        The accepted nodes and leaf bodies are collected into interactions, with the accepted nodes' quadrupole moments
+        for a multipole order of 2, and evaluated in one batch by the selected force kernel.  The number of interactions is recorded as the particle's cost.  Returns the number of nodes
+        visited.
+    */
+    int calculateNetForce(ParticleStore& particles, int particle_index, double theta, InteractionList& interactions);
+
+    /*  Calculates the net force onto a group of particles in [begin, end) with a single walk of the tree.  A node is
+        used as a whole only if it is far enough away from the group's bounding box, so it would also be accepted by
+        every particle of the group on its own.  The shared interaction list is then evaluated for every particle.
+        Particles next to each other in the store should also be close in space, e.g. after a Morton build.  Returns
+        the number of nodes visited.
+    */
+    int calculateNetForceGroup(ParticleStore& particles, int begin, int end, double theta, InteractionList& interactions);
+
+    /*  Calculates the net force onto the particles in [begin, end), walking the tree once per group of group_size
+        consecutive particles, or once per particle when group_size is 1 or less.  The particles are spread across the
+        process's threads with dynamic scheduling, each thread using its own interaction list.  If step is given, every
+        particle or group is integrated right after its net force, while it is still in cache.  Moving a particle does
+        not change the forces on the others, the tree keeps its own copy of the positions.  Returns the number of
+        nodes visited.
+    */
+    long calculateNetForces(ParticleStore& particles, int begin, int end, double theta, int group_size, IntegrationStep* step = nullptr);
+
+    /*  Appends to sources the x, y and mass of what a process whose bodies lie in the bounding box needs from this
+        tree to calculate their net forces.  The tree is walked like calculateNetForceGroup(): a node far enough away
+        from the box is appended as a single pseudo-particle at its center of mass, an opened leaf appends its bodies.
+        Pseudo-particles do not carry the node's quadrupole moments.
+    */
+    void collectEssentialSources(double min_x, double min_y, double max_x, double max_y, double theta, vector<double>& sources);
+
+    // Returns the flattened tree laid out by flatten() or buildMortonShared().
+    vector<FlatNode>& getFlatNodes();
+
+    // Returns the positions and masses of the flattened tree's leaf bodies, in the order of its leaves.
+    vector<double>& getFlatXPos();
+    vector<double>& getFlatYPos();
+    vector<double>& getFlatMass();
+
+    // Returns the index of every flat body in the bodies vector the tree was built from.
+    vector<int>& getFlatBodyIndex();
+
+    // Returns the node pool index of the root node.
+    int getRoot();
+
+    // Returns a reference to the node at node_index of the node pool.
+    TreeNode& getNode(int node_index);
+
+    // Returns the number of nodes in the node pool.
+    int getNodeCount();
+
+    // Traverses the tree from the root to print out the internal space nodes and external space nodes.
+    void printTree();
+
+   private:
+    // Subtree whose bodies are the sorted bodies in [begin, end), built by a thread of a parallel Morton build.
+    struct MortonTask {
+        int node_index;
+        int begin, end;
+    };
+
+    int leaf_size;
+    double space_length;
+    opening_t opening;
+    int multipole_order;
+    vector<TreeNode> nodes;
+    body* bodies;
+    vector<int> next_body;  // Next body in the same leaf for each body, -1 for the leaf's last body.
+
+    // State of updateMorton(): the leaf every body is in (-1 for bodies outside of the tree), whether a body left it, the bodies that did, and the bodies moved since and the bodies and nodes in the tree at the last rebuild.
+    vector<int> body_leaf;
+    vector<char> body_moved;
+    vector<int> moved_bodies;
+    long moved_since_rebuild;
+    int rebuilt_bodies;
+    size_t rebuilt_nodes;
+
+    // Flattened tree and the positions and masses of its leaves' bodies.
+    vector<FlatNode> flat_nodes;
+    vector<double> flat_x_pos, flat_y_pos, flat_mass;
+    vector<int> flat_body_index;
+
+    // Traceless quadrupole moments xx, xy and yy of every flat node about its center of mass, for a multipole order of 2.
+    vector<double> flat_moments;
+
+    // Interaction list of each thread, kept between steps to avoid reallocating them.
+    vector<InteractionList> thread_interactions;
+
+    // Scratch space of buildMorton(), kept between steps to avoid reallocating it.
+    vector<uint64_t> keys, keys_buffer;
+    vector<int> order, order_buffer;
+    vector<body> bodies_buffer;
+
+    // Bodies below every node, counted by calculateCenterOfMass().
+    vector<int> subtree_bodies;
+
+    // Subtrees of a parallel Morton build and the node pools the threads build them in.
+    vector<MortonTask> morton_tasks;
+    vector<vector<TreeNode>> task_nodes;
+
+    // Values in a subtree's summary: its number of flat nodes, the sums of its root and its root's radius.
+    static const int TASK_SUMMARY_SIZE = 5;
+
+    // Scratch space of buildMortonShared(): the flattened subtrees of the process, those of all processes in subtree order, where each subtree starts among them, the subtrees' summaries and the subtree rooted at each top node, or -1.
+    vector<vector<FlatNode>> task_flat_nodes;
+    vector<FlatNode> shared_flat_nodes;
+    vector<int> task_flat_begin;
+    vector<double> task_summaries;
+    vector<int> node_tasks;
+
+    // Bytes buildMortonShared() sent to and received from other processes since the last getTraffic().
+    double bytes_sent, bytes_received;
+
+    /* Private Functions */
+    // Creates children TreeNodes for NW, NE, SW, SE spaces at the end of the node pool.
+    void subdivide(vector<TreeNode>& pool, int node_index);
+
+    // Returns the pool index of the child of node_index the body falls in, or -1 if the body is outside of the node's space.
+    int selectChild(int node_index, body& body);
+
+    // Adds the body at body_index to the end of the leaf node_index, so a leaf lists its bodies in the order they were added, like buildMortonNode().
+    void addLeafBody(int node_index, int body_index);
+
+    // Takes the body at body_index out of the leaf node_index.
+    void removeLeafBody(int node_index, int body_index);
+
+    // Sums up the center of mass of leaf node_index of pool from its bodies and, for OPENING_BMAX, measures its radius to the farthest one.
+    void sumLeaf(vector<TreeNode>& pool, int node_index);
+
+    // Sums up the center of mass of internal node node_index of pool from its children and, for OPENING_BMAX, bounds its radius by theirs and by its space.
+    void sumChildren(vector<TreeNode>& pool, int node_index);
+
+    // Returns the squared size of node compared against theta, its space length or, with OPENING_BMAX, its radius.
+    double getOpeningSizeSq(TreeNode& node);
+
+    // Records the leaf of every body in body_leaf after a build.
+    void indexLeaves();
+
+    // Returns the end of the sorted bodies in [begin, end) that fall in quadrant, or a quadrant before it, at level.
+    int findQuadrantEnd(int begin, int end, int level, int quadrant);
+
+    // Builds the subtree of node_index of pool from the sorted bodies in [begin, end) and sums up its center of mass from its children.
+    void buildMortonNode(vector<TreeNode>& pool, int node_index, int begin, int end);
+
+    // Sorts the bodies along the Z-curve and resets the tree to them.  Returns the number of bodies still in the simulation.
+    int sortMorton(vector<body>& bodies);
+
+    // Returns the level the tree is split at for workers threads to build several subtrees each.
+    int getSplitLevel(int workers);
+
+    // Builds the tree from the sorted bodies in [0, bodies_end), with the subtrees below split_level built by the process's threads.
+    void buildMortonParallel(int bodies_end);
+
+    // Subdivides the nodes above split_level like buildMortonNode() and records the subtrees at split_level as MortonTasks.
+    void buildMortonTop(int node_index, int begin, int end, int split_level);
+
+    // Sums up the center of mass of the nodes above split_level from their children once the subtrees are built.
+    void sumCenterOfMassTop(int node_index, int split_level);
+
+    // Sums up the quadrupole moments of the flattened tree bottom-up, from the leaves' bodies and the children's moments shifted to their parent's center of mass.
+    void calculateMoments();
+
+    // Appends the subtree of node_index to the flattened tree, leaving out empty leaves.
+    void flattenNode(int node_index);
+
+    /*  Appends the subtree of node_index of a subtree's pool to task_flat like flattenNode(), with next counted from
+        the start of task_flat and body_begin the leaf's first sorted body instead of its first flat body.
+    */
+    void flattenTask(vector<TreeNode>& pool, int node_index, vector<FlatNode>& task_flat);
+
+    // Appends the subtree of top node node_index to the flattened tree, copying in the exchanged subtrees.
+    void flattenShared(int node_index);
+
+    void printTree(int node_index);
+};
@@ -56,4 +56,13 @@ void body::printBodyNoSpace() {
 
 void body::printBodyRank(int rank) {
     printf("rank(%d) body: (%d, %.6f, %.6f, %.6f, %.6f, %.6f) force: (%.6f, %.6f) \n", rank, index, x_pos, y_pos, mass, x_vel, y_vel, F_x, F_y);
-}
\ No newline at end of file
+}
+
+void body::applyUpdate(body_update& update) {
+    x_pos = update.x_pos;
+    y_pos = update.y_pos;
+    x_vel = update.x_vel;
+    y_vel = update.y_vel;
+    mass = update.mass;
+    cost = update.cost;
+}
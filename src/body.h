@@ -5,6 +5,16 @@
 // Custom Libraries
 #include "argparse.h"
 
+/*  State of a body that a step changes, exchanged between processes in place of the whole body when positions are
+    sent as floats.  The index never changes and the net force is recalculated every step, so neither is sent.
+*/
+struct body_update {
+    float x_pos, y_pos;  // Position, rounded to float.
+    int cost;
+    double x_vel, y_vel;
+    double mass;  // Only changes to -1 when the body is lost.
+};
+
 /*  The duple is in the following structure.
         index (int): the index of each particle is considered as the particle's name.  Therefore, in the output file, the order of particles does not matter since each particle will be tracked by its index. You should keep the index of each particle safely with the particle because the autograder will check the correctness of the output file based on the index of each particle.
         x_position (double)
@@ -15,12 +25,13 @@
 */
 struct body {
     int index;  // index identifier of the body.
+    int cost;  // Interactions evaluated for the body's last net force, used to split the work across processes.
     double x_pos, y_pos;  // x and y coordinate positions of a body.
     double mass;  // The mass of the body.
     double x_vel, y_vel;  // The velocity of the body.
     double F_x, F_y;  // Projected x or y force on the body.
 
-    body(int input_index = 0, double input_x_pos = 0, double input_y_pos = 0, double input_mass = 0, double input_x_vel = 0, double input_y_vel = 0, double input_F_x = 0, double input_F_y = 0) : index(input_index), x_pos(input_x_pos), y_pos(input_y_pos), mass(input_mass), x_vel(input_x_vel), y_vel(input_y_vel), F_x(input_F_x), F_y(input_F_y) {}
+    body(int input_index = 0, double input_x_pos = 0, double input_y_pos = 0, double input_mass = 0, double input_x_vel = 0, double input_y_vel = 0, double input_F_x = 0, double input_F_y = 0, int input_cost = 0) : index(input_index), cost(input_cost), x_pos(input_x_pos), y_pos(input_y_pos), mass(input_mass), x_vel(input_x_vel), y_vel(input_y_vel), F_x(input_F_x), F_y(input_F_y) {}
 
     // Resets the x and y forces to 0, to recalculate the acting forces on the body.
     void resetForce();
@@ -39,4 +50,7 @@ struct body {
     void printBody();
     void printBodyRank(int rank);
     void printBodyNoSpace();
+
+    // Sets the body's position, velocity, mass and cost to the ones of an update.
+    void applyUpdate(body_update& update);
 };
\ No newline at end of file
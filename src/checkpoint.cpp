@@ -0,0 +1,118 @@
+#include "checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+Checkpointer::Checkpointer(const char* input_prefix, options_t& opts) {
+    prefix = input_prefix;
+    dt = opts.dt;
+    theta = opts.theta;
+    checkpoints = 0;
+
+    // A checkpoint only continues a run of the same input with the same physics.
+    config_hash = calculateHash(opts.input_filename, strlen(opts.input_filename));
+    config_hash = calculateHash(&opts.dt, sizeof(opts.dt), config_hash);
+    config_hash = calculateHash(&opts.theta, sizeof(opts.theta), config_hash);
+    config_hash = calculateHash(&opts.integrator, sizeof(opts.integrator), config_hash);
+}
+
+Checkpointer::~Checkpointer() {
+    wait();
+}
+
+int Checkpointer::restore(vector<body>& bodies) {
+    vector<body> slot_bodies[2];
+    int slot_steps[2];
+    for (int slot = 0; slot < 2; ++slot) {
+        slot_steps[slot] = readFile(prefix + "." + to_string(slot), slot_bodies[slot]);
+    }
+
+    int newest = (slot_steps[1] > slot_steps[0]) ? 1 : 0;
+    if (slot_steps[newest] == -1) {
+        return -1;
+    }
+
+    // The next checkpoint overwrites the older one.
+    checkpoints = newest + 1;
+    bodies.swap(slot_bodies[newest]);
+    return slot_steps[newest];
+}
+
+void Checkpointer::write(vector<body>& bodies, int step) {
+    wait();
+
+    snapshot = bodies;
+    string filename = prefix + "." + to_string(checkpoints % 2);
+    ++checkpoints;
+    writer = thread(&Checkpointer::writeFile, this, filename, step);
+}
+
+void Checkpointer::wait() {
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+void Checkpointer::writeFile(string filename, int step) {
+    checkpoint_header header;
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = CHECKPOINT_VERSION;
+    header.body_size = sizeof(body);
+    header.config_hash = config_hash;
+    header.step = step;
+    header.dt = dt;
+    header.theta = theta;
+    header.count = snapshot.size();
+    header.checksum = calculateHash(snapshot.data(), snapshot.size() * sizeof(body));
+
+    string temporary_filename = prefix + ".tmp";
+    FILE* out = fopen(temporary_filename.c_str(), "wb");
+    if (out == NULL) {
+        std::cerr << "checkpoint: cannot open " << temporary_filename << "." << std::endl;
+        return;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 && fwrite(snapshot.data(), sizeof(body), snapshot.size(), out) == snapshot.size();
+
+    // The data has to be on disk before the rename makes it the checkpoint.
+    written = fflush(out) == 0 && fsync(fileno(out)) == 0 && written;
+    fclose(out);
+
+    if (!written || rename(temporary_filename.c_str(), filename.c_str()) != 0) {
+        std::cerr << "checkpoint: cannot write " << filename << "." << std::endl;
+    }
+}
+
+int Checkpointer::readFile(string filename, vector<body>& bodies) {
+    FILE* in = fopen(filename.c_str(), "rb");
+    if (in == NULL) {
+        return -1;
+    }
+
+    checkpoint_header header;
+    bool valid = fread(&header, sizeof(header), 1, in) == 1 && memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0 && header.version == CHECKPOINT_VERSION && header.body_size == sizeof(body) && header.config_hash == config_hash && header.dt == dt && header.theta == theta;
+
+    // A corrupt count must not allocate more bodies than the file holds, so the restore falls back to the other checkpoint instead.
+    struct stat file_stat;
+    valid = valid && fstat(fileno(in), &file_stat) == 0 && header.count <= (static_cast<uint64_t>(file_stat.st_size) - sizeof(header)) / sizeof(body) && header.count <= INT_MAX;
+    if (valid) {
+        bodies.resize(header.count);
+        valid = fread(bodies.data(), sizeof(body), header.count, in) == header.count && calculateHash(bodies.data(), header.count * sizeof(body)) == header.checksum;
+    }
+    fclose(in);
+
+    return valid ? header.step : -1;
+}
+
+uint64_t calculateHash(const void* data, size_t size, uint64_t hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
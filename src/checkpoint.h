@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+
+using namespace std;
+
+// Bytes a checkpoint file starts with.
+const char CHECKPOINT_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'C', 'K', 'P'};
+
+// Version of the checkpoint file format.
+const uint32_t CHECKPOINT_VERSION = 1;
+
+/*  Header of a checkpoint file, followed by count bodies exactly as they are laid out in memory.  A checkpoint is
+    only restored if it is complete, its checksum matches its bodies and it was written by a run with the same
+    configuration.
+*/
+struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t body_size;  // sizeof(body) of the writer, so a changed body layout is never misread.
+    uint64_t config_hash;
+    int64_t step;  // Next step to run.
+    double dt, theta;
+    uint64_t count;
+    uint64_t checksum;  // FNV-1a hash of the bodies.
+};
+
+/*  Writes checkpoints of the simulation in the background and restores the newest one at startup.  Checkpoints
+    alternate between two files, <prefix>.0 and <prefix>.1, so a run killed while writing one still has the other.
+    Each file is written to <prefix>.tmp first and renamed into place once it is complete.
+*/
+class Checkpointer {
+   public:
+    /* Public Functions */
+    // Creates a checkpointer for the checkpoint files of prefix, for runs configured like opts.
+    Checkpointer(const char* input_prefix, options_t& opts);
+
+    // Waits for the checkpoint being written.
+    ~Checkpointer();
+
+    /*  Reads the newest valid checkpoint into bodies and returns the step it was taken before, or -1 if there is
+        no valid checkpoint for this configuration.
+    */
+    int restore(vector<body>& bodies);
+
+    /*  Copies the bodies and starts writing them as the checkpoint of step in a background thread.  Waits for the
+        previous checkpoint first if it is still being written.
+    */
+    void write(vector<body>& bodies, int step);
+
+    // Waits for the checkpoint being written.
+    void wait();
+
+   private:
+    string prefix;
+    uint64_t config_hash;
+    double dt, theta;
+    int checkpoints;  // Checkpoints written so far, selects the file the next one goes to.
+
+    vector<body> snapshot;
+    thread writer;
+
+    /* Private Functions */
+    // Writes snapshot as the checkpoint of step to filename.
+    void writeFile(string filename, int step);
+
+    // Reads the checkpoint file into bodies if it is valid and returns its step, or -1.
+    int readFile(string filename, vector<body>& bodies);
+};
+
+// Returns the FNV-1a hash of size bytes, continuing from hash.
+uint64_t calculateHash(const void* data, size_t size, uint64_t hash = 14695981039346656037ull);
@@ -0,0 +1,209 @@
+#include "decomposition.h"
+
+#include <algorithm>
+
+// Custom Libraries
+#include "morton.h"
+#include "parallel.h"
+
+Decomposition::Decomposition(MPI_Comm input_comm, MPI_Datatype input_body_dt, balance_t input_balance) {
+    comm = input_comm;
+    body_dt = input_body_dt;
+    balance = input_balance;
+    MPI_Comm_size(comm, &comm_size);
+    MPI_Comm_rank(comm, &comm_rank);
+    MPI_Type_size(body_dt, &body_size);
+    bytes_sent = 0;
+    bytes_received = 0;
+
+    split_cells.assign(comm_size + 1, 0);
+    send_counts.resize(comm_size);
+    send_displacements.resize(comm_size);
+    recv_counts.resize(comm_size);
+    recv_displacements.resize(comm_size);
+}
+
+void Decomposition::scatter(vector<body>& all_bodies, vector<body>& bodies, int records, int root) {
+    int bodies_per_process = records / comm_size;
+    for (int p = 0; p < comm_size; ++p) {
+        send_counts[p] = (p == comm_size - 1) ? records - bodies_per_process * (comm_size - 1) : bodies_per_process;
+    }
+    calculateDisplacements(send_counts, send_displacements);
+
+    bodies.resize(send_counts[comm_rank]);
+    if (comm_rank == root) {
+        bytes_sent += static_cast<double>(records - send_counts[comm_rank]) * body_size;
+    } else {
+        bytes_received += static_cast<double>(send_counts[comm_rank]) * body_size;
+    }
+    MPI_Scatterv(all_bodies.data(), send_counts.data(), send_displacements.data(), body_dt, bodies.data(), send_counts[comm_rank], body_dt, root, comm);
+}
+
+void Decomposition::partition(vector<body>& bodies) {
+    int bodies_end = sortBodies(bodies);
+
+    // Weigh every cell of the Z-curve by the work of the bodies in it across all processes.
+    int cells = 1 << (2 * DECOMPOSITION_LEVELS);
+    int cell_shift = 2 * (MORTON_BITS - DECOMPOSITION_LEVELS);
+    cell_weights.assign(cells, 0);
+    for (int i = 0; i < bodies_end; ++i) {
+        cell_weights[keys[i] >> cell_shift] += getBodyWork(bodies[i], balance);
+    }
+    global_cell_weights.resize(cells);
+    MPI_Allreduce(cell_weights.data(), global_cell_weights.data(), cells, MPI_DOUBLE, MPI_SUM, comm);
+    splitCells();
+
+    // The bodies are sorted by key, so the bodies of every owner already follow each other in rank order.
+    fill(send_counts.begin(), send_counts.end(), 0);
+    for (int i = 0; i < bodies_end; ++i) {
+        ++send_counts[getOwner(keys[i])];
+    }
+    calculateDisplacements(send_counts, send_displacements);
+
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+    int recv_size = calculateDisplacements(recv_counts, recv_displacements);
+    countTraffic(body_size);
+
+    // Lost bodies stay where they are, after the received bodies.
+    int lost_size = bodies.size() - bodies_end;
+    bodies_buffer.resize(recv_size + lost_size);
+    MPI_Alltoallv(bodies.data(), send_counts.data(), send_displacements.data(), body_dt, bodies_buffer.data(), recv_counts.data(), recv_displacements.data(), body_dt, comm);
+    copy(bodies.begin() + bodies_end, bodies.end(), bodies_buffer.begin() + recv_size);
+    bodies.swap(bodies_buffer);
+
+    // Every sender's bodies arrive sorted, but the senders' ranges overlap within the range of this process.
+    sortBodies(bodies);
+}
+
+void Decomposition::exchangeEssentialTrees(BHTree& local_tree, vector<body>& bodies, double theta, vector<body>& sources) {
+    // Bounding box of the bodies still in the simulation, left inverted when there are none.
+    double bounding_box[4] = {4, 4, 0, 0};
+    for (body& body : bodies) {
+        if (body.mass != -1) {
+            bounding_box[0] = min(bounding_box[0], body.x_pos);
+            bounding_box[1] = min(bounding_box[1], body.y_pos);
+            bounding_box[2] = max(bounding_box[2], body.x_pos);
+            bounding_box[3] = max(bounding_box[3], body.y_pos);
+        }
+    }
+    bounding_boxes.resize(4 * comm_size);
+    MPI_Allgather(bounding_box, 4, MPI_DOUBLE, bounding_boxes.data(), 4, MPI_DOUBLE, comm);
+
+    send_sources.clear();
+    for (int p = 0; p < comm_size; ++p) {
+        int begin = send_sources.size();
+        double* box = &bounding_boxes[4 * p];
+        if (p != comm_rank && box[0] <= box[2]) {
+            local_tree.collectEssentialSources(box[0], box[1], box[2], box[3], theta, send_sources);
+        }
+        send_counts[p] = send_sources.size() - begin;
+    }
+    calculateDisplacements(send_counts, send_displacements);
+
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+    int recv_size = calculateDisplacements(recv_counts, recv_displacements);
+    countTraffic(sizeof(double));
+
+    recv_sources.resize(recv_size);
+    MPI_Alltoallv(send_sources.data(), send_counts.data(), send_displacements.data(), MPI_DOUBLE, recv_sources.data(), recv_counts.data(), recv_displacements.data(), MPI_DOUBLE, comm);
+
+    // Imported sources only add force, they have no index and are never integrated.
+    sources.clear();
+    for (body& body : bodies) {
+        if (body.mass != -1) {
+            sources.emplace_back(-1, body.x_pos, body.y_pos, body.mass);
+        }
+    }
+    for (int i = 0; i < recv_size; i += 3) {
+        sources.emplace_back(-1, recv_sources[i], recv_sources[i + 1], recv_sources[i + 2]);
+    }
+}
+
+void Decomposition::gather(vector<body>& bodies, vector<body>& all_bodies, int root) {
+    int bodies_size = bodies.size();
+    MPI_Gather(&bodies_size, 1, MPI_INT, recv_counts.data(), 1, MPI_INT, root, comm);
+    int recv_size = calculateDisplacements(recv_counts, recv_displacements);
+
+    if (comm_rank == root) {
+        all_bodies.resize(recv_size);
+        bytes_received += static_cast<double>(recv_size - bodies_size) * body_size;
+    } else {
+        bytes_sent += static_cast<double>(bodies_size) * body_size;
+    }
+    MPI_Gatherv(bodies.data(), bodies_size, body_dt, all_bodies.data(), recv_counts.data(), recv_displacements.data(), body_dt, root, comm);
+}
+
+void Decomposition::getTraffic(double* sent, double* received) {
+    *sent = bytes_sent;
+    *received = bytes_received;
+    bytes_sent = 0;
+    bytes_received = 0;
+}
+
+int Decomposition::sortBodies(vector<body>& bodies) {
+    int bodies_size = bodies.size();
+
+    keys.resize(bodies_size);
+    order.resize(bodies_size);
+    for (int i = 0; i < bodies_size; ++i) {
+        body& body = bodies[i];
+        keys[i] = (body.mass == -1) ? LOST_MORTON_KEY : calculateMortonKey(body.x_pos, body.y_pos, 4);
+        order[i] = i;
+    }
+
+    radixSortKeys(keys, order, keys_buffer, order_buffer);
+
+    bodies_buffer.resize(bodies_size);
+    for (int i = 0; i < bodies_size; ++i) {
+        bodies_buffer[i] = bodies[order[i]];
+    }
+    bodies.swap(bodies_buffer);
+
+    return lower_bound(keys.begin(), keys.end(), LOST_MORTON_KEY) - keys.begin();
+}
+
+void Decomposition::splitCells() {
+    int cells = global_cell_weights.size();
+
+    double total_weight = 0;
+    for (int cell = 0; cell < cells; ++cell) {
+        total_weight += global_cell_weights[cell];
+    }
+
+    // A process's range starts at the first cell whose preceding cells hold its share of the weight.
+    double weight = 0;
+    int p = 1;
+    split_cells[0] = 0;
+    for (int cell = 0; cell < cells; ++cell) {
+        while (p < comm_size && weight >= total_weight * p / comm_size) {
+            split_cells[p++] = cell;
+        }
+        weight += global_cell_weights[cell];
+    }
+    while (p <= comm_size) {
+        split_cells[p++] = cells;
+    }
+}
+
+int Decomposition::getOwner(uint64_t key) {
+    int cell = static_cast<int>(key >> (2 * (MORTON_BITS - DECOMPOSITION_LEVELS)));
+    return upper_bound(split_cells.begin(), split_cells.end() - 1, cell) - split_cells.begin() - 1;
+}
+
+int Decomposition::calculateDisplacements(vector<int>& counts, vector<int>& displacements) {
+    int total = 0;
+    for (int p = 0; p < comm_size; ++p) {
+        displacements[p] = total;
+        total += counts[p];
+    }
+    return total;
+}
+
+void Decomposition::countTraffic(int element_size) {
+    for (int p = 0; p < comm_size; ++p) {
+        if (p != comm_rank) {
+            bytes_sent += static_cast<double>(send_counts[p]) * element_size;
+            bytes_received += static_cast<double>(recv_counts[p]) * element_size;
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <cstdint>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "bhtree.h"
+#include "body.h"
+
+using namespace std;
+
+// Number of tree levels of the Morton key prefix the space is split on.  The space is cut into 4^DECOMPOSITION_LEVELS cells that are handed out to the processes in Z-curve order.
+const int DECOMPOSITION_LEVELS = 8;
+
+/*  Splits the bodies of a distributed run across processes along the Z-curve.  Every process owns the bodies whose
+    Morton key falls in its range of the curve, so the bodies of a process cover a compact region of space and only
+    the bodies that crossed a range boundary move between processes from one step to the next.  The ranges are
+    chosen from a global histogram of the bodies' key prefixes, weighted by the bodies' work, so every process gets
+    about as much work.
+    Lost bodies are never sent anywhere, they stay with the process that lost them until they are gathered for the
+    output.
+*/
+class Decomposition {
+   public:
+    /* Public Functions */
+    // Creates a decomposition across the processes of comm, sending bodies as body_dt and weighing them by balance.
+    Decomposition(MPI_Comm input_comm, MPI_Datatype input_body_dt, balance_t input_balance);
+
+    // Hands every process a block of records consecutive bodies from all_bodies of the root into bodies.
+    void scatter(vector<body>& all_bodies, vector<body>& bodies, int records, int root);
+
+    /*  Recomputes the ranges of the Z-curve and sends the bodies that are not in the range of the calling process
+        to their owners.  Afterwards the bodies are sorted by Morton key, with the lost bodies at the end.
+    */
+    void partition(vector<body>& bodies);
+
+    /*  Exchanges the locally essential trees of the processes.  Every process sends every other process the parts of
+        local_tree, the tree of its own bodies, that the other process needs under the theta opening criterion for the
+        bounding box of its bodies: pseudo-particles for the nodes far enough away and single bodies only where the
+        tree has to be opened.  Only the x, y and mass of each of them are sent.  sources is filled with the process's
+        own bodies followed by everything it received, for building the tree the forces are calculated from.
+    */
+    void exchangeEssentialTrees(BHTree& local_tree, vector<body>& bodies, double theta, vector<body>& sources);
+
+    // Collects the bodies of every process into all_bodies of the root.
+    void gather(vector<body>& bodies, vector<body>& all_bodies, int root);
+
+    // Returns the bytes the calling process sent to and received from other processes since the last call.
+    void getTraffic(double* sent, double* received);
+
+   private:
+    MPI_Comm comm;
+    MPI_Datatype body_dt;
+    balance_t balance;
+    int comm_size, comm_rank;
+    int body_size;
+
+    // Bytes sent to and received from other processes since the last getTraffic().
+    double bytes_sent, bytes_received;
+
+    // First cell of the range of each process, followed by the number of cells.
+    vector<int> split_cells;
+
+    // Scratch space of partition(), kept between steps to avoid reallocating it.
+    vector<double> cell_weights, global_cell_weights;
+    vector<uint64_t> keys, keys_buffer;
+    vector<int> order, order_buffer;
+    vector<body> bodies_buffer;
+    vector<int> send_counts, send_displacements, recv_counts, recv_displacements;
+    vector<double> bounding_boxes;
+    vector<double> send_sources, recv_sources;
+
+    /* Private Functions */
+    // Sorts bodies by Morton key, with the lost bodies at the end, and leaves their keys in keys.  Returns the number of bodies still in the simulation.
+    int sortBodies(vector<body>& bodies);
+
+    // Fills split_cells so the processes' ranges of cells hold about the same weight.
+    void splitCells();
+
+    // Returns the process owning the cell of a Morton key.
+    int getOwner(uint64_t key);
+
+    // Fills the displacements of counts and returns their total.
+    int calculateDisplacements(vector<int>& counts, vector<int>& displacements);
+
+    // Adds the elements of element_size bytes in send_counts and recv_counts of the other processes to the traffic.
+    void countTraffic(int element_size);
+};
@@ -0,0 +1,385 @@
+#include "fmm.h"
+
+#include <math.h>
+#include <omp.h>
+
+#include <algorithm>
+
+// Custom Libraries
+#include "helpers.h"
+
+// Returns the number of coefficients of an expansion up to degree.
+static constexpr int countCoefficients(int degree) {
+    return ((degree + 1) * (degree + 2)) / 2;
+}
+
+// Derivatives of 1 / |r| a translation from a multipole to a local expansion needs at most, up to the highest order since n + k never exceeds the order.
+static const int FMM_MAX_DERIVATIVES = countCoefficients(FMM_MAX_ORDER);
+
+// Returns the index of the coefficient of (n_x, n_y) in an expansion, whose coefficients are ordered by degree n_x + n_y and then by n_y.
+static inline int coefficientIndex(int n_x, int n_y) {
+    int degree = n_x + n_y;
+    return ((degree * (degree + 1)) / 2) + n_y;
+}
+
+// Fills scaled_powers with d^j / j! for every j up to degree.
+static inline void calculateScaledPowers(double d, int degree, double* scaled_powers) {
+    scaled_powers[0] = 1;
+    for (int j = 1; j <= degree; ++j) {
+        scaled_powers[j] = scaled_powers[j - 1] * d / j;
+    }
+}
+
+/*  Fills derivatives with d^n/dx^n (1 / |r|) at r = (x, y) for every n up to degree, in the order of coefficientIndex().
+    The McMurchie-Davidson recurrence builds them from the scaled radial derivatives
+        R^m_0 = (-1)^m (2m - 1)!! / |r|^(2m + 1)
+        R^m_(n + e_x) = x R^(m + 1)_n + n_x R^(m + 1)_(n - e_x), and the same for y
+    where the derivatives are D_n = R^0_n.  Every m only needs the one above it, so two buffers are enough.
+*/
+static void calculateDerivatives(double x, double y, int degree, double* derivatives) {
+    double inverse_distance_sq = 1 / ((x * x) + (y * y));
+    double radial[FMM_MAX_ORDER + 1];
+    radial[0] = sqrt(inverse_distance_sq);
+    for (int m = 1; m <= degree; ++m) {
+        radial[m] = -(2 * m - 1) * inverse_distance_sq * radial[m - 1];
+    }
+
+    double buffers[2][FMM_MAX_DERIVATIVES];
+    double* higher = buffers[0];
+    double* current = buffers[1];
+    for (int m = degree; m >= 0; --m) {
+        if (m == 0) {
+            current = derivatives;
+        }
+
+        current[0] = radial[m];
+        for (int d = 1; d <= degree - m; ++d) {
+            for (int n_y = 0; n_y <= d; ++n_y) {
+                int n_x = d - n_y;
+                double value;
+                if (n_x > 0) {
+                    value = x * higher[coefficientIndex(n_x - 1, n_y)];
+                    if (n_x > 1) {
+                        value += (n_x - 1) * higher[coefficientIndex(n_x - 2, n_y)];
+                    }
+                } else {
+                    value = y * higher[coefficientIndex(0, n_y - 1)];
+                    if (n_y > 1) {
+                        value += (n_y - 1) * higher[coefficientIndex(0, n_y - 2)];
+                    }
+                }
+                current[coefficientIndex(n_x, n_y)] = value;
+            }
+        }
+        swap(higher, current);
+    }
+}
+
+FmmSolver::FmmSolver(BHTree& input_tree, double input_theta, double input_tolerance) : tree(input_tree) {
+    theta = input_theta;
+    order = selectOrder(theta, input_tolerance);
+    coefficients = countCoefficients(order);
+}
+
+int FmmSolver::selectOrder(double theta, double tolerance) {
+    int order = 2;
+    while (order < FMM_MAX_ORDER && pow(theta, order + 1) > tolerance) {
+        ++order;
+    }
+    return order;
+}
+
+long FmmSolver::prepare(ParticleStore& particles) {
+    vector<FlatNode>& flat_nodes = tree.getFlatNodes();
+    int flat_nodes_size = flat_nodes.size();
+    radii.resize(flat_nodes_size);
+    multipoles.assign(static_cast<size_t>(flat_nodes_size) * coefficients, 0);
+    locals.assign(static_cast<size_t>(flat_nodes_size) * coefficients, 0);
+    near_leaves.resize(flat_nodes_size);
+
+    subtrees.clear();
+    top_nodes.clear();
+    if (flat_nodes_size > 0) {
+        splitTree(0, 0);
+    }
+    int subtrees_size = subtrees.size();
+
+    // Children follow their parent in the flattened tree, so walking a subtree backwards sums up every child before its parent.
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int s = 0; s < subtrees_size; ++s) {
+        for (int i = flat_nodes[subtrees[s]].next - 1; i >= subtrees[s]; --i) {
+            sumMultipoles(i);
+        }
+    }
+    for (int i = static_cast<int>(top_nodes.size()) - 1; i >= 0; --i) {
+        sumMultipoles(top_nodes[i]);
+    }
+
+    // Every subtree takes the interactions of the whole tree on its own, so only its thread writes its local expansions and near leaves.
+    long visits = 0;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(+ : visits)
+    for (int s = 0; s < subtrees_size; ++s) {
+        int subtree_end = flat_nodes[subtrees[s]].next;
+        for (int i = subtrees[s]; i < subtree_end; ++i) {
+            near_leaves[i].clear();
+        }
+
+        visits += interact(subtrees[s], 0);
+
+        for (int i = subtrees[s]; i < subtree_end; ++i) {
+            passLocals(i);
+        }
+    }
+
+    // Particles are the bodies the tree was built from, lost bodies are not in any leaf.
+    vector<int>& flat_body_index = tree.getFlatBodyIndex();
+    target_leaf.assign(particles.size(), -1);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < flat_nodes_size; ++i) {
+        FlatNode& node = flat_nodes[i];
+        for (int j = node.body_begin; j < node.body_begin + node.body_count; ++j) {
+            target_leaf[flat_body_index[j]] = i;
+        }
+    }
+
+    return visits;
+}
+
+long FmmSolver::calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) {
+    vector<FlatNode>& flat_nodes = tree.getFlatNodes();
+    vector<double>& flat_x_pos = tree.getFlatXPos();
+    vector<double>& flat_y_pos = tree.getFlatYPos();
+    vector<double>& flat_mass = tree.getFlatMass();
+
+    thread_interactions.resize(omp_get_max_threads());
+    long visits = 0;
+
+    #pragma omp parallel reduction(+ : visits)
+    {
+        // Bodies of the near leaves of interactions_leaf.  Particles next to each other mostly share their leaf, so the list is only rebuilt when it changes.
+        InteractionList& interactions = thread_interactions[omp_get_thread_num()];
+        int interactions_leaf = -1;
+
+        #pragma omp for schedule(dynamic, 64)
+        for (int i = begin; i < end; ++i) {
+            particles.F_x[i] = 0;
+            particles.F_y[i] = 0;
+            particles.cost[i] = 0;
+
+            int leaf = target_leaf[i];
+            if (leaf != -1) {
+                if (leaf != interactions_leaf) {
+                    interactions.clear();
+                    for (int near_leaf : near_leaves[leaf]) {
+                        FlatNode& node = flat_nodes[near_leaf];
+                        interactions.append(&flat_x_pos[node.body_begin], &flat_y_pos[node.body_begin], &flat_mass[node.body_begin], node.body_count);
+                    }
+                    interactions_leaf = leaf;
+                }
+                visits += near_leaves[leaf].size();
+
+                // The far field is the gradient of the leaf's local expansion at the particle.
+                double x = particles.x_pos[i];
+                double y = particles.y_pos[i];
+                FlatNode& node = flat_nodes[leaf];
+                double* local = &locals[static_cast<size_t>(leaf) * coefficients];
+                double scaled_x[FMM_MAX_ORDER + 1], scaled_y[FMM_MAX_ORDER + 1];
+                calculateScaledPowers(x - node.com_x, order - 1, scaled_x);
+                calculateScaledPowers(y - node.com_y, order - 1, scaled_y);
+
+                double F_x = 0;
+                double F_y = 0;
+                for (int d = 0; d < order; ++d) {
+                    for (int n_y = 0; n_y <= d; ++n_y) {
+                        int n_x = d - n_y;
+                        double weight = scaled_x[n_x] * scaled_y[n_y];
+                        F_x += local[coefficientIndex(n_x + 1, n_y)] * weight;
+                        F_y += local[coefficientIndex(n_x, n_y + 1)] * weight;
+                    }
+                }
+
+                // The near field is summed directly, the particle itself adds nothing.
+                accumulateForce(x, y, interactions, &F_x, &F_y);
+
+                particles.cost[i] = interactions.size();
+                particles.F_x[i] = G * particles.mass[i] * F_x;
+                particles.F_y[i] = G * particles.mass[i] * F_y;
+            }
+
+            if (step != nullptr) {
+                particles.integrate(i, *step);
+            }
+        }
+    }
+
+    return visits;
+}
+
+void FmmSolver::splitTree(int node_index, int level) {
+    vector<FlatNode>& flat_nodes = tree.getFlatNodes();
+    FlatNode& node = flat_nodes[node_index];
+    if (level == FMM_SPLIT_LEVEL || node.body_count > 0) {
+        subtrees.push_back(node_index);
+        return;
+    }
+
+    top_nodes.push_back(node_index);
+    for (int child = node_index + 1; child < node.next; child = flat_nodes[child].next) {
+        splitTree(child, level + 1);
+    }
+}
+
+void FmmSolver::sumMultipoles(int node_index) {
+    vector<FlatNode>& flat_nodes = tree.getFlatNodes();
+    FlatNode& node = flat_nodes[node_index];
+    double* multipole = &multipoles[static_cast<size_t>(node_index) * coefficients];
+    double scaled_x[FMM_MAX_ORDER + 1], scaled_y[FMM_MAX_ORDER + 1];
+
+    if (node.body_count > 0) {
+        vector<double>& flat_x_pos = tree.getFlatXPos();
+        vector<double>& flat_y_pos = tree.getFlatYPos();
+        vector<double>& flat_mass = tree.getFlatMass();
+
+        double radius_sq = 0;
+        for (int j = node.body_begin; j < node.body_begin + node.body_count; ++j) {
+            double d_x = flat_x_pos[j] - node.com_x;
+            double d_y = flat_y_pos[j] - node.com_y;
+            radius_sq = max(radius_sq, (d_x * d_x) + (d_y * d_y));
+
+            calculateScaledPowers(d_x, order, scaled_x);
+            calculateScaledPowers(d_y, order, scaled_y);
+            for (int d = 0; d <= order; ++d) {
+                for (int n_y = 0; n_y <= d; ++n_y) {
+                    multipole[coefficientIndex(d - n_y, n_y)] += flat_mass[j] * scaled_x[d - n_y] * scaled_y[n_y];
+                }
+            }
+        }
+        radii[node_index] = sqrt(radius_sq);
+        return;
+    }
+
+    // A child's expansion about its center of mass c moves to the parent's p with M_n += sum over k <= n of M_k (c - p)^(n - k) / (n - k)!.
+    double radius = 0;
+    for (int child = node_index + 1; child < node.next; child = flat_nodes[child].next) {
+        FlatNode& child_node = flat_nodes[child];
+        double* child_multipole = &multipoles[static_cast<size_t>(child) * coefficients];
+        double d_x = child_node.com_x - node.com_x;
+        double d_y = child_node.com_y - node.com_y;
+        radius = max(radius, sqrt((d_x * d_x) + (d_y * d_y)) + radii[child]);
+
+        calculateScaledPowers(d_x, order, scaled_x);
+        calculateScaledPowers(d_y, order, scaled_y);
+        for (int d = 0; d <= order; ++d) {
+            for (int n_y = 0; n_y <= d; ++n_y) {
+                int n_x = d - n_y;
+                double sum = 0;
+                for (int k_x = 0; k_x <= n_x; ++k_x) {
+                    for (int k_y = 0; k_y <= n_y; ++k_y) {
+                        sum += child_multipole[coefficientIndex(k_x, k_y)] * scaled_x[n_x - k_x] * scaled_y[n_y - k_y];
+                    }
+                }
+                multipole[coefficientIndex(n_x, n_y)] += sum;
+            }
+        }
+    }
+    radii[node_index] = radius;
+}
+
+long FmmSolver::interact(int target, int source) {
+    vector<FlatNode>& flat_nodes = tree.getFlatNodes();
+    FlatNode& target_node = flat_nodes[target];
+    FlatNode& source_node = flat_nodes[source];
+
+    double d_x = target_node.com_x - source_node.com_x;
+    double d_y = target_node.com_y - source_node.com_y;
+    double distance = sqrt((d_x * d_x) + (d_y * d_y));
+    double radii_sum = radii[target] + radii[source];
+
+    // Every body pair of the two nodes is closer than rlimit, where the force m d / rlimit^3 is linear in the positions.  The source then acts exactly like its mass at its center of mass with the potential -M |r - c|^2 / (2 rlimit^3), which an expansion of order 2 holds.
+    if (distance + radii_sum <= rlimit) {
+        double* local = &locals[static_cast<size_t>(target) * coefficients];
+        double curvature = -source_node.mass / (rlimit * rlimit * rlimit);
+        local[coefficientIndex(1, 0)] += curvature * d_x;
+        local[coefficientIndex(0, 1)] += curvature * d_y;
+        local[coefficientIndex(2, 0)] += curvature;
+        local[coefficientIndex(0, 2)] += curvature;
+        return 1;
+    }
+
+    // The source's potential at the target's center of mass, differentiated up to order: L_n += sum over k of (-1)^|k| M_k D_(n + k)(d).
+    if (radii_sum < theta * distance && distance - radii_sum >= rlimit) {
+        double derivatives[FMM_MAX_DERIVATIVES];
+        calculateDerivatives(d_x, d_y, order, derivatives);
+
+        double* local = &locals[static_cast<size_t>(target) * coefficients];
+        double* multipole = &multipoles[static_cast<size_t>(source) * coefficients];
+        for (int k = 0; k <= order; ++k) {
+            // Expansions are about the center of mass, so their dipole moments are zero.
+            if (k == 1) {
+                continue;
+            }
+            for (int k_y = 0; k_y <= k; ++k_y) {
+                int k_x = k - k_y;
+                double moment = (k % 2 == 0) ? multipole[coefficientIndex(k_x, k_y)] : -multipole[coefficientIndex(k_x, k_y)];
+                for (int d = 0; d <= order - k; ++d) {
+                    for (int n_y = 0; n_y <= d; ++n_y) {
+                        local[coefficientIndex(d - n_y, n_y)] += moment * derivatives[coefficientIndex(d - n_y + k_x, n_y + k_y)];
+                    }
+                }
+            }
+        }
+        return 1;
+    }
+
+    bool target_is_leaf = target_node.body_count > 0;
+    bool source_is_leaf = source_node.body_count > 0;
+    if (target_is_leaf && source_is_leaf) {
+        near_leaves[target].push_back(source);
+        return 1;
+    }
+
+    // Split the larger of the two nodes, or the one that is not a leaf.
+    long visits = 1;
+    if (target_is_leaf || (!source_is_leaf && radii[source] >= radii[target])) {
+        for (int child = source + 1; child < source_node.next; child = flat_nodes[child].next) {
+            visits += interact(target, child);
+        }
+    } else {
+        for (int child = target + 1; child < target_node.next; child = flat_nodes[child].next) {
+            visits += interact(child, source);
+        }
+    }
+    return visits;
+}
+
+void FmmSolver::passLocals(int node_index) {
+    vector<FlatNode>& flat_nodes = tree.getFlatNodes();
+    FlatNode& node = flat_nodes[node_index];
+    if (node.body_count > 0) {
+        return;
+    }
+
+    // The parent's expansion about p moves to a child's center of mass c with L_n += sum over k of L_(n + k) (c - p)^k / k!.
+    double* local = &locals[static_cast<size_t>(node_index) * coefficients];
+    double scaled_x[FMM_MAX_ORDER + 1], scaled_y[FMM_MAX_ORDER + 1];
+    for (int child = node_index + 1; child < node.next; child = flat_nodes[child].next) {
+        FlatNode& child_node = flat_nodes[child];
+        double* child_local = &locals[static_cast<size_t>(child) * coefficients];
+        calculateScaledPowers(child_node.com_x - node.com_x, order, scaled_x);
+        calculateScaledPowers(child_node.com_y - node.com_y, order, scaled_y);
+
+        for (int d = 0; d <= order; ++d) {
+            for (int n_y = 0; n_y <= d; ++n_y) {
+                int n_x = d - n_y;
+                double sum = 0;
+                for (int k = 0; k <= order - d; ++k) {
+                    for (int k_y = 0; k_y <= k; ++k_y) {
+                        int k_x = k - k_y;
+                        sum += local[coefficientIndex(n_x + k_x, n_y + k_y)] * scaled_x[k_x] * scaled_y[k_y];
+                    }
+                }
+                child_local[coefficientIndex(n_x, n_y)] += sum;
+            }
+        }
+    }
+}
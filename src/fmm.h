@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+// Custom Libraries
+#include "bhtree.h"
+#include "kernels.h"
+#include "particles.h"
+#include "solver.h"
+
+using namespace std;
+
+// Highest expansion order the fast multipole method supports.  The lowest is 2, see FmmSolver.
+const int FMM_MAX_ORDER = 10;
+
+/*  Fast multipole method over the flattened Barnes-Hut Tree.  The bodies attract each other with the same 1 / d^2 force
+    as the other solvers, the gradient of the potential sum of m / |r| in the plane, so the expansions are Cartesian
+    Taylor series in x and y up to order, about every node's center of mass:
+        multipole  M_n = sum of m (s - c)^n / n!                       over the node's bodies s
+        local      L_n = d^n/dx^n phi(c)                               of the potential of the far bodies
+    with n a pair of exponents (n_x, n_y).  prepare() sums up the multipole expansions from the leaves up, walks pairs
+    of nodes down from the root in a dual tree traversal, and passes the local expansions down to the leaves.  A target
+    node takes a source node's multipole expansion into its local expansion once
+        r_target + r_source < theta * d   and   d - r_target - r_source >= rlimit
+    with r the distance from a node's center of mass to its farthest body and d between the centers of mass, so no body
+    pair of the two nodes is close enough for rlimit to matter.  Nodes whose bodies are all within rlimit of each other
+    feel the linear force of the clamped distance, which a local expansion holds exactly.  Otherwise the larger node is
+    split, and a pair of leaves is summed up directly.  Every body's net force is then its leaf's local expansion plus its leaf's near
+    leaves, summed like an opened leaf of the Barnes-Hut traversal.  The tree is split below FMM_SPLIT_LEVEL into
+    subtrees the process's threads work on, which are always the same, so the forces do not depend on the number of
+    threads.
+*/
+class FmmSolver : public ForceSolver {
+   public:
+    // Creates a solver of the tree for an opening angle of theta, with expansions up to the order selectOrder() picks for the relative force error tolerance.
+    FmmSolver(BHTree& input_tree, double input_theta, double input_tolerance);
+
+    // Returns the lowest expansion order whose error at an opening angle of theta, about theta^(order + 1), is below tolerance, from 2 up to FMM_MAX_ORDER.
+    static int selectOrder(double theta, double tolerance);
+
+    long prepare(ParticleStore& particles) override;
+
+    long calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) override;
+
+   private:
+    // Depth of the subtrees the process's threads work on.
+    static const int FMM_SPLIT_LEVEL = 3;
+
+    BHTree& tree;
+    double theta;
+    int order;
+    int coefficients;  // Coefficients of an expansion up to order.
+
+    // Radius, multipole and local expansion of every flat node, and the leaves every flat leaf sums up directly.
+    vector<double> radii;
+    vector<double> multipoles, locals;
+    vector<vector<int>> near_leaves;
+
+    // Flat leaf of every particle, -1 for lost bodies.
+    vector<int> target_leaf;
+
+    // Roots of the subtrees below FMM_SPLIT_LEVEL, and the nodes above them in depth-first order.
+    vector<int> subtrees, top_nodes;
+
+    // Interaction list of each thread, kept between steps to avoid reallocating them.
+    vector<InteractionList> thread_interactions;
+
+    /* Private Functions */
+    // Records node_index at level as a subtree if it is at FMM_SPLIT_LEVEL or a leaf, and splits it further otherwise.
+    void splitTree(int node_index, int level);
+
+    // Sums up the multipole expansion and the radius of node_index from its bodies or its children's expansions.
+    void sumMultipoles(int node_index);
+
+    // Adds the source node's bodies to the local expansions of the target node and its descendants, or to the near leaves of its leaves.  Returns the number of node pairs visited.
+    long interact(int target, int source);
+
+    // Shifts the local expansion of node_index to its children and adds it to theirs.
+    void passLocals(int node_index);
+};
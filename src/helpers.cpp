@@ -14,10 +14,6 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-/* Global Variables / Constants */
-// If the distance between two bodies are shorter than rlimit, then rlimit is used as the distance between the two bodies
-const double rlimit = 0.03;
-
 double calculateDistance(double x1, double y1, double x2, double y2) {
     double x_dif = x2 - x1;
     double y_dif = y2 - y1;
@@ -96,7 +92,8 @@ double getWindowSpaceLength(double space_length) {
 }
 
 // Draw the QuadTree bounds onto the glfw window.
-void drawQuadTreeBounds2D(TreeNode& node) {
+void drawQuadTreeBounds2D(BHTree& tree, int node_index) {
+    TreeNode& node = tree.getNode(node_index);
     // int i;
 
     /*
@@ -132,10 +129,8 @@ void drawQuadTreeBounds2D(TreeNode& node) {
 
     /* for each subtree of node
        drawOctreeBounds2D(subtree); */
-    vector<shared_ptr<TreeNode>>* children = node.getChildren();
-    int children_size = children->size();
-    for (int i = 0; i < children_size; ++i) {
-        drawQuadTreeBounds2D(*(*children)[i]);
+    for (int i = 0; i < 4; ++i) {
+        drawQuadTreeBounds2D(tree, node.first_child + i);
     }
 }
 
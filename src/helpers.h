@@ -4,11 +4,18 @@
 
 // Custom Libraries
 #include "body.h"
-#include "treenode.h"
+#include "bhtree.h"
 
 // namespaces
 using namespace std;
 
+/* Global Variables / Constants */
+// Universal Gravitational Constant
+const double G = 0.0001;
+
+// If the distance between two bodies are shorter than rlimit, then rlimit is used as the distance between the two bodies
+const double rlimit = 0.03;
+
 // Calculates the distance between two points with their x and y points.
 double calculateDistance(double x1, double y1, double x2, double y2);
 
@@ -35,7 +42,7 @@ double getWindowPoint(double point);
 double getWindowSpaceLength(double space_length);
 
 // Draw the QuadTree bounds onto the glfw window.
-void drawQuadTreeBounds2D(TreeNode& node);
+void drawQuadTreeBounds2D(BHTree& tree, int node_index);
 
 // Draw the particle body onto the glfw window.
 void drawParticle2D(double x_window, double y_window,
@@ -1,58 +1,170 @@
 #include <io.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <climits>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iomanip>
 
-void read_file(struct options_t* args,
-               vector<body>& bodies) {
-    // Open file
-    std::ifstream in;
-    in.open(args->input_filename);
-    // Get num vals
-    in >> args->records;
+// Bytes the text writer collects before handing them to the file.
+const int WRITE_BUFFER_SIZE = 1 << 20;
 
-    // Alloc input and output arrays.  Each record in the input file contains a record ID and 5 other dimensions.
-    /* 	x_position
-        y_position
-        mass
-        x_velocity
-        y_velocity
-    */
-    int records_dims = args->records;
+bool isBinaryBodyFile(const char* filename) {
+    char magic[8] = {0};
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
 
-    // printf("io: records_dims: %d \n", records_dims);  // debug statement
+    return read == sizeof(magic) && memcmp(magic, BODY_FILE_MAGIC, sizeof(magic)) == 0;
+}
 
-    // Read input vals
+bool hasBinaryExtension(const char* filename) {
+    size_t length = strlen(filename);
+    return length >= 4 && strcmp(filename + length - 4, ".bin") == 0;
+}
+
+body_file_header createBodyFileHeader(uint64_t count) {
+    body_file_header header;
+    memcpy(header.magic, BODY_FILE_MAGIC, sizeof(header.magic));
+    header.version = BODY_FILE_VERSION;
+    header.header_size = sizeof(body_file_header);
+    header.dtype = BODY_FILE_FLOAT64;
+    header.layout = BODY_FILE_COLUMNS;
+    header.count = count;
+    return header;
+}
+
+bool checkBodyFileHeader(body_file_header& header, uint64_t file_size, const char* filename) {
+    if (file_size < sizeof(body_file_header) || memcmp(header.magic, BODY_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        std::cerr << "io: " << filename << " is not a binary body file." << std::endl;
+        return false;
+    }
+    if (header.version != BODY_FILE_VERSION || header.dtype != BODY_FILE_FLOAT64 || header.layout != BODY_FILE_COLUMNS) {
+        std::cerr << "io: " << filename << " has version " << header.version << ", dtype " << header.dtype << " and layout " << header.layout << ", which are not supported." << std::endl;
+        return false;
+    }
+    if (header.header_size < sizeof(body_file_header) || header.header_size % sizeof(double) != 0 || header.header_size > file_size) {
+        std::cerr << "io: " << filename << " has an invalid header size of " << header.header_size << " bytes." << std::endl;
+        return false;
+    }
+
+    // Bound the count by the file size before multiplying it, so a corrupt count cannot wrap the offsets around.
+    uint64_t body_size = sizeof(int32_t) + (BODY_FILE_COLUMN_COUNT - 1) * sizeof(double);
+    if (header.count > (file_size - header.header_size) / body_size || header.count > INT_MAX || getBodyFileColumnOffset(header, BODY_FILE_COLUMN_COUNT) > file_size) {
+        std::cerr << "io: " << filename << " is shorter than its " << header.count << " bodies." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t getBodyFileColumnOffset(body_file_header& header, int column) {
+    // The index column is followed by the value columns, padded so they start on a multiple of 8 bytes.
+    if (column == 0) {
+        return header.header_size;
+    }
+    uint64_t index_size = (header.count * sizeof(int32_t) + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+    return header.header_size + index_size + (column - 1) * header.count * sizeof(double);
+}
+
+// Reads a binary body file through a memory map, copying every column into the bodies.
+static void readBinaryFile(struct options_t* args, vector<body>& bodies, const char* data, uint64_t size) {
+    body_file_header header;
+    memcpy(&header, data, min<uint64_t>(size, sizeof(header)));
+    if (!checkBodyFileHeader(header, size, args->input_filename)) {
+        exit(1);
+    }
+
+    int count = header.count;
+    args->records = count;
+    bodies.resize(count);
+
+    const int32_t* indices = reinterpret_cast<const int32_t*>(data + getBodyFileColumnOffset(header, 0));
+    const double* columns[5];
+    for (int column = 1; column < BODY_FILE_COLUMN_COUNT; ++column) {
+        columns[column - 1] = reinterpret_cast<const double*>(data + getBodyFileColumnOffset(header, column));
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < count; ++i) {
+        bodies[i] = body(indices[i], columns[0][i], columns[1][i], columns[2][i], columns[3][i], columns[4][i]);
+    }
+}
+
+// Parses the next whitespace separated value of [text, end) into value and returns where parsing stopped.
+template <typename T>
+static const char* parseValue(const char* text, const char* end, T& value, const char* filename) {
+    while (text < end && isspace(static_cast<unsigned char>(*text))) {
+        ++text;
+    }
+
+    from_chars_result result = from_chars(text, end, value);
+    if (result.ec != errc()) {
+        std::cerr << "io: " << filename << " has a missing or invalid value." << std::endl;
+        exit(1);
+    }
+    return result.ptr;
+}
+
+// Parses a text body file: the number of bodies followed by one index, x_pos, y_pos, mass, x_vel, y_vel record per body.
+static void readTextFile(struct options_t* args, vector<body>& bodies, const char* data, uint64_t size) {
+    const char* text = data;
+    const char* end = data + size;
+
+    text = parseValue(text, end, args->records, args->input_filename);
+
+    int records_dims = args->records;
+    bodies.resize(records_dims);
     for (int i = 0; i < records_dims; ++i) {
-        int indx;
-        double x_pos, y_pos, mass, x_vel, y_vel;
-        for (int j = 0; j < 6; ++j) {
-            switch (j) {
-                case 0:
-                    in >> indx;
-                    break;
-                case 1:
-                    in >> x_pos;
-                    break;
-                case 2:
-                    in >> y_pos;
-                    break;
-                case 3:
-                    in >> mass;
-                    //printf("mass: %.7f \n", mass);  // debug statement
-                    break;
-                case 4:
-                    in >> x_vel;
-                    break;
-                case 5:
-                    in >> y_vel;
-                    break;
-            }
-        }
-        bodies.push_back(body(indx, x_pos, y_pos, mass, x_vel, y_vel));
+        body& body = bodies[i];
+        text = parseValue(text, end, body.index, args->input_filename);
+        text = parseValue(text, end, body.x_pos, args->input_filename);
+        text = parseValue(text, end, body.y_pos, args->input_filename);
+        text = parseValue(text, end, body.mass, args->input_filename);
+        text = parseValue(text, end, body.x_vel, args->input_filename);
+        text = parseValue(text, end, body.y_vel, args->input_filename);
+    }
+}
+
+void read_file(struct options_t* args,
+               vector<body>& bodies) {
+    int file = open(args->input_filename, O_RDONLY);
+    struct stat file_stat;
+    if (file == -1 || fstat(file, &file_stat) != 0) {
+        std::cerr << "io: cannot open " << args->input_filename << "." << std::endl;
+        exit(1);
+    }
+
+    // Both formats are read straight out of the page cache instead of being copied through a stream buffer.
+    uint64_t size = file_stat.st_size;
+    void* data = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    close(file);
+    if (data == MAP_FAILED) {
+        std::cerr << "io: cannot map " << args->input_filename << "." << std::endl;
+        exit(1);
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    const char* bytes = static_cast<const char*>(data);
+    if (size >= sizeof(BODY_FILE_MAGIC) && memcmp(bytes, BODY_FILE_MAGIC, sizeof(BODY_FILE_MAGIC)) == 0) {
+        readBinaryFile(args, bodies, bytes, size);
+    } else {
+        readTextFile(args, bodies, bytes, size);
     }
 
+    munmap(data, size);
+
     // printf("io: bodies.size: %d \n", static_cast<int>(bodies.size()));  //debug statement
 }
 
@@ -85,21 +197,61 @@ void read_file2(struct options_t* args,
     }
 }
 
+// Writes the bodies as a binary body file, one column at a time.
+static void writeBinaryFile(FILE* out, vector<body>& bodies) {
+    int bodies_size = bodies.size();
+    body_file_header header = createBodyFileHeader(bodies_size);
+    fwrite(&header, sizeof(header), 1, out);
+
+    vector<int32_t> indices(bodies_size);
+    for (int i = 0; i < bodies_size; ++i) {
+        indices[i] = bodies[i].index;
+    }
+    fwrite(indices.data(), sizeof(int32_t), bodies_size, out);
+
+    // Pad the index column so the value columns are 8 byte aligned.
+    int32_t padding = 0;
+    fwrite(&padding, sizeof(int32_t), bodies_size % 2, out);
+
+    vector<double> column(bodies_size);
+    double body::*fields[5] = {&body::x_pos, &body::y_pos, &body::mass, &body::x_vel, &body::y_vel};
+    for (double body::*field : fields) {
+        for (int i = 0; i < bodies_size; ++i) {
+            column[i] = bodies[i].*field;
+        }
+        fwrite(column.data(), sizeof(double), bodies_size, out);
+    }
+}
+
+// Writes the bodies as text, formatting them into a large buffer instead of flushing every line.
+static void writeTextFile(FILE* out, vector<body>& bodies) {
+    vector<char> buffer(WRITE_BUFFER_SIZE);
+    int used = snprintf(buffer.data(), WRITE_BUFFER_SIZE, "%d\n", (int)bodies.size());
+
+    for (body& body : bodies) {
+        // A line is at most about 80 characters, flush well before the buffer could overflow.
+        if (used > WRITE_BUFFER_SIZE - 256) {
+            fwrite(buffer.data(), 1, used, out);
+            used = 0;
+        }
+        used += snprintf(buffer.data() + used, WRITE_BUFFER_SIZE - used, "%d\t%.6e\t%.6e\t%.6e\t%.6e\t%.6e\n", body.index, body.x_pos, body.y_pos, body.mass, body.x_vel, body.y_vel);
+    }
+    fwrite(buffer.data(), 1, used, out);
+}
+
 void write_file(options_t* args,
                 vector<body>& bodies) {
-     // Open file
-	std::ofstream out;
-	out.open(args->output_filename, std::ofstream::trunc);
-
-	// Write solution to output file
-    out.precision(6);
-    out << setprecision(6) << fixed << scientific;
-    out << (int)bodies.size() << endl;
-	for (int i = 0; i < (int)bodies.size(); ++i) {
-		out << bodies[i].index << "\t" << bodies[i].x_pos << "\t" << bodies[i].y_pos << "\t" << bodies[i].mass << "\t" << bodies[i].x_vel << "\t" << bodies[i].y_vel << std::endl;
-		//printf("io: Writing from i(%d) the value: %d \n", i, opts->output_vals[i]); // debug statement
-	}
-
-	out.flush();
-	out.close();
-}
\ No newline at end of file
+    FILE* out = fopen(args->output_filename, "wb");
+    if (out == NULL) {
+        std::cerr << "io: cannot open " << args->output_filename << "." << std::endl;
+        exit(1);
+    }
+
+    if (hasBinaryExtension(args->output_filename)) {
+        writeBinaryFile(out, bodies);
+    } else {
+        writeTextFile(out, bodies);
+    }
+
+    fclose(out);
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -8,11 +9,59 @@
 
 using namespace std;
 
+// Bytes a binary body file starts with.
+const char BODY_FILE_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'B', 'I', 'N'};
+
+// Version of the binary body file format written by write_file().  Version 2 pads the index column so the value columns are 8 byte aligned.
+const uint32_t BODY_FILE_VERSION = 2;
+
+// Element type of the value columns of a binary body file.
+const uint32_t BODY_FILE_FLOAT64 = 1;
+
+// Layout of a binary body file: one column per field instead of one record per body.
+const uint32_t BODY_FILE_COLUMNS = 1;
+
+// Number of columns of a binary body file: index, x_pos, y_pos, mass, x_vel and y_vel.
+const int BODY_FILE_COLUMN_COUNT = 6;
+
+/*  Header of a binary body file.  It is followed by the bodies' columns, each one count values long and in this
+    order: index (int32), x_pos, y_pos, mass, x_vel and y_vel (dtype).  The index column is padded to a multiple of 8
+    bytes and header_size is one too, so every value column can be read in place as doubles.  Values are stored in the
+    byte order of the machine that wrote the file.
+*/
+struct body_file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;  // Bytes from the start of the file to the first column.
+    uint32_t dtype;
+    uint32_t layout;
+    uint64_t count;
+};
+
+// True if the file starts with BODY_FILE_MAGIC.
+bool isBinaryBodyFile(const char* filename);
+
+// True if the file name ends in .bin, in which case write_file() writes a binary body file.
+bool hasBinaryExtension(const char* filename);
+
+// Returns the header of a binary body file with count bodies.
+body_file_header createBodyFileHeader(uint64_t count);
+
+// Checks a header read from a binary body file of file_size bytes, before any of its offsets are calculated.  Prints the problem and returns false if the file cannot be read.
+bool checkBodyFileHeader(body_file_header& header, uint64_t file_size, const char* filename);
+
+// Returns the byte offset of a column (0 for index to 5 for y_vel) in a binary body file.
+uint64_t getBodyFileColumnOffset(body_file_header& header, int column);
+
+/*  Reads the bodies of the input file into bodies and their number into records.  Binary body files are memory
+    mapped and copied column by column, text files are parsed in place with from_chars.
+*/
 void read_file(struct options_t* args,
                vector<body>& bodies);
 
 void read_file2(struct options_t* args,
                double** bodies_array);
 
+// Writes the bodies to the output file, as a binary body file if its name ends in .bin and as text otherwise.
 void write_file(struct options_t* args,
-                vector<body>& bodies);
\ No newline at end of file
+                vector<body>& bodies);
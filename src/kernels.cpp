@@ -0,0 +1,188 @@
+#include "kernels.h"
+
+#include <immintrin.h>
+#include <math.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Custom Libraries
+#include "helpers.h"
+
+void InteractionList::clear() {
+    x_pos.clear();
+    y_pos.clear();
+    mass.clear();
+    quadrupole_x.clear();
+    quadrupole_y.clear();
+    quadrupole_xx.clear();
+    quadrupole_xy.clear();
+    quadrupole_yy.clear();
+}
+
+void InteractionList::add(double x, double y, double source_mass) {
+    x_pos.push_back(x);
+    y_pos.push_back(y);
+    mass.push_back(source_mass);
+}
+
+void InteractionList::addQuadrupole(double x, double y, const double* moments) {
+    quadrupole_x.push_back(x);
+    quadrupole_y.push_back(y);
+    quadrupole_xx.push_back(moments[0]);
+    quadrupole_xy.push_back(moments[1]);
+    quadrupole_yy.push_back(moments[2]);
+}
+
+void InteractionList::append(const double* x, const double* y, const double* source_mass, int count) {
+    x_pos.insert(x_pos.end(), x, x + count);
+    y_pos.insert(y_pos.end(), y, y + count);
+    mass.insert(mass.end(), source_mass, source_mass + count);
+}
+
+int InteractionList::size() {
+    return x_pos.size();
+}
+
+static void accumulateForceScalar(double x, double y, const double* source_x, const double* source_y, const double* source_mass, int count, double* F_x, double* F_y) {
+    double sum_x = 0;
+    double sum_y = 0;
+    for (int i = 0; i < count; ++i) {
+        double d_x = source_x[i] - x;
+        double d_y = source_y[i] - y;
+        double distance = max(sqrt((d_x * d_x) + (d_y * d_y)), rlimit);
+        double weight = source_mass[i] / (distance * distance * distance);
+        sum_x += weight * d_x;
+        sum_y += weight * d_y;
+    }
+    *F_x += sum_x;
+    *F_y += sum_y;
+}
+
+// The vector kernels are compiled for their instruction set through target attributes, so the rest of the program does not need the matching -m flags and still runs on CPUs without them.
+__attribute__((target("avx2,fma"))) static void accumulateForceAVX2(double x, double y, const double* source_x, const double* source_y, const double* source_mass, int count, double* F_x, double* F_y) {
+    __m256d target_x = _mm256_set1_pd(x);
+    __m256d target_y = _mm256_set1_pd(y);
+    __m256d limit = _mm256_set1_pd(rlimit);
+    __m256d sum_x = _mm256_setzero_pd();
+    __m256d sum_y = _mm256_setzero_pd();
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d d_x = _mm256_sub_pd(_mm256_loadu_pd(source_x + i), target_x);
+        __m256d d_y = _mm256_sub_pd(_mm256_loadu_pd(source_y + i), target_y);
+        __m256d distance = _mm256_max_pd(_mm256_sqrt_pd(_mm256_fmadd_pd(d_x, d_x, _mm256_mul_pd(d_y, d_y))), limit);
+        __m256d weight = _mm256_div_pd(_mm256_loadu_pd(source_mass + i), _mm256_mul_pd(_mm256_mul_pd(distance, distance), distance));
+        sum_x = _mm256_fmadd_pd(weight, d_x, sum_x);
+        sum_y = _mm256_fmadd_pd(weight, d_y, sum_y);
+    }
+
+    double lanes_x[4], lanes_y[4];
+    _mm256_storeu_pd(lanes_x, sum_x);
+    _mm256_storeu_pd(lanes_y, sum_y);
+    *F_x += (lanes_x[0] + lanes_x[1]) + (lanes_x[2] + lanes_x[3]);
+    *F_y += (lanes_y[0] + lanes_y[1]) + (lanes_y[2] + lanes_y[3]);
+
+    accumulateForceScalar(x, y, source_x + i, source_y + i, source_mass + i, count - i, F_x, F_y);
+}
+
+// GCC's AVX-512 intrinsics headers fill unused operands with self-initialized _mm512_undefined_pd() values, which trips -Wuninitialized once inlined.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+__attribute__((target("avx512f"))) static void accumulateForceAVX512(double x, double y, const double* source_x, const double* source_y, const double* source_mass, int count, double* F_x, double* F_y) {
+    __m512d target_x = _mm512_set1_pd(x);
+    __m512d target_y = _mm512_set1_pd(y);
+    __m512d limit = _mm512_set1_pd(rlimit);
+    __m512d sum_x = _mm512_setzero_pd();
+    __m512d sum_y = _mm512_setzero_pd();
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m512d d_x = _mm512_sub_pd(_mm512_loadu_pd(source_x + i), target_x);
+        __m512d d_y = _mm512_sub_pd(_mm512_loadu_pd(source_y + i), target_y);
+        __m512d distance = _mm512_max_pd(_mm512_sqrt_pd(_mm512_fmadd_pd(d_x, d_x, _mm512_mul_pd(d_y, d_y))), limit);
+        __m512d weight = _mm512_div_pd(_mm512_loadu_pd(source_mass + i), _mm512_mul_pd(_mm512_mul_pd(distance, distance), distance));
+        sum_x = _mm512_fmadd_pd(weight, d_x, sum_x);
+        sum_y = _mm512_fmadd_pd(weight, d_y, sum_y);
+    }
+
+    // The remaining sources are handled with a masked iteration instead of the scalar loop.
+    if (i < count) {
+        __mmask8 mask = static_cast<__mmask8>((1u << (count - i)) - 1);
+        __m512d d_x = _mm512_sub_pd(_mm512_mask_loadu_pd(target_x, mask, source_x + i), target_x);
+        __m512d d_y = _mm512_sub_pd(_mm512_mask_loadu_pd(target_y, mask, source_y + i), target_y);
+        __m512d distance = _mm512_max_pd(_mm512_sqrt_pd(_mm512_fmadd_pd(d_x, d_x, _mm512_mul_pd(d_y, d_y))), limit);
+        __m512d weight = _mm512_div_pd(_mm512_maskz_loadu_pd(mask, source_mass + i), _mm512_mul_pd(_mm512_mul_pd(distance, distance), distance));
+        sum_x = _mm512_fmadd_pd(weight, d_x, sum_x);
+        sum_y = _mm512_fmadd_pd(weight, d_y, sum_y);
+    }
+
+    *F_x += _mm512_reduce_add_pd(sum_x);
+    *F_y += _mm512_reduce_add_pd(sum_y);
+}
+#pragma GCC diagnostic pop
+
+static force_kernel_t force_kernel = accumulateForceScalar;
+static const char* force_kernel_name = "scalar";
+
+bool selectForceKernel(const char* isa) {
+    __builtin_cpu_init();
+    bool has_avx512 = __builtin_cpu_supports("avx512f");
+    bool has_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    if (strcmp(isa, "auto") == 0) {
+        isa = has_avx512 ? "avx512" : (has_avx2 ? "avx2" : "scalar");
+    }
+
+    if (strcmp(isa, "avx512") == 0 && has_avx512) {
+        force_kernel = accumulateForceAVX512;
+        force_kernel_name = "avx512";
+    } else if (strcmp(isa, "avx2") == 0 && has_avx2) {
+        force_kernel = accumulateForceAVX2;
+        force_kernel_name = "avx2";
+    } else if (strcmp(isa, "scalar") == 0) {
+        force_kernel = accumulateForceScalar;
+        force_kernel_name = "scalar";
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* getForceKernelName() {
+    return force_kernel_name;
+}
+
+// Adds the quadrupole corrections of the list's nodes, which are few next to its sources, so a scalar loop is enough.
+static void accumulateQuadrupoles(double x, double y, InteractionList& sources, double* F_x, double* F_y) {
+    const double* source_x = sources.quadrupole_x.data();
+    const double* source_y = sources.quadrupole_y.data();
+    const double* q_xx = sources.quadrupole_xx.data();
+    const double* q_xy = sources.quadrupole_xy.data();
+    const double* q_yy = sources.quadrupole_yy.data();
+    double rlimit_sq = rlimit * rlimit;
+    double sum_x = 0;
+    double sum_y = 0;
+    int count = sources.quadrupole_x.size();
+    for (int i = 0; i < count; ++i) {
+        double d_x = source_x[i] - x;
+        double d_y = source_y[i] - y;
+        double inverse_sq = 1 / max((d_x * d_x) + (d_y * d_y), rlimit_sq);
+        double inverse_5 = inverse_sq * inverse_sq * sqrt(inverse_sq);
+        double q_d_x = (q_xx[i] * d_x) + (q_xy[i] * d_y);
+        double q_d_y = (q_xy[i] * d_x) + (q_yy[i] * d_y);
+        double weight = 2.5 * ((d_x * q_d_x) + (d_y * q_d_y)) * inverse_sq;
+        sum_x += inverse_5 * ((weight * d_x) - q_d_x);
+        sum_y += inverse_5 * ((weight * d_y) - q_d_y);
+    }
+    *F_x += sum_x;
+    *F_y += sum_y;
+}
+
+void accumulateForce(double x, double y, InteractionList& sources, double* F_x, double* F_y) {
+    force_kernel(x, y, sources.x_pos.data(), sources.y_pos.data(), sources.mass.data(), sources.size(), F_x, F_y);
+    if (!sources.quadrupole_x.empty()) {
+        accumulateQuadrupoles(x, y, sources, F_x, F_y);
+    }
+}
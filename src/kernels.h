@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+using namespace std;
+
+/*  Sources a target body interacts with, stored as a structure of arrays so force kernels can load several sources
+    at once.  A source is either a body or the center of mass of a tree node accepted as a whole.  Accepted nodes may
+    also add their quadrupole moments, which correct the force of their center of mass.
+*/
+struct InteractionList {
+    vector<double> x_pos, y_pos;
+    vector<double> mass;
+    vector<double> quadrupole_x, quadrupole_y;  // Center of mass of each node with quadrupole moments.
+    vector<double> quadrupole_xx, quadrupole_xy, quadrupole_yy;  // Traceless quadrupole moments of each node about its center of mass.
+
+    // Removes all sources while keeping the arrays' capacity.
+    void clear();
+
+    // Appends a source to the list.
+    void add(double x, double y, double source_mass);
+
+    // Appends the quadrupole moments xx, xy and yy of a node whose center of mass is at (x, y).  The node itself is added with add().
+    void addQuadrupole(double x, double y, const double* moments);
+
+    // Appends count sources stored as separate position and mass arrays to the list.
+    void append(const double* x, const double* y, const double* source_mass, int count);
+
+    // Returns the number of sources in the list.
+    int size();
+};
+
+/*  Force kernel signature.  Accumulates into F_x and F_y the sum over count sources of
+        mass * dx / d^3 and mass * dy / d^3
+    for a target at (x, y), with d clamped to rlimit.  The caller multiplies the sums by G and the target's mass.
+    A source at the target's own position contributes nothing, so a body may be in its own list.
+*/
+typedef void (*force_kernel_t)(double x, double y, const double* source_x, const double* source_y, const double* source_mass, int count, double* F_x, double* F_y);
+
+// Selects the force kernel for an instruction set: "auto" picks the best one the CPU supports at runtime, or one of "avx512", "avx2" and "scalar".  Returns false if the CPU does not support the requested instruction set, in which case the selection is unchanged.
+bool selectForceKernel(const char* isa);
+
+// Returns the name of the instruction set of the selected force kernel.
+const char* getForceKernelName();
+
+/*  Runs the selected force kernel over an interaction list and adds the quadrupole corrections of its nodes.  A node
+    with the traceless moments Q at d from the target adds
+        (5/2) (d^T Q d) d / d^7 - Q d / d^5
+    with d clamped to rlimit like the kernels do.
+*/
+void accumulateForce(double x, double y, InteractionList& sources, double* F_x, double* F_y);
@@ -1,4 +1,5 @@
 #include <mpi.h>  // MPI libraries
+#include <omp.h>  // OpenMP threads within a process
 
 #include <chrono>
 #include <cstddef>
@@ -18,10 +19,19 @@
 
 // Custom Libraries
 #include "argparse.h"
+#include "bhtree.h"
 #include "body.h"
+#include "checkpoint.h"
+#include "decomposition.h"
 #include "helpers.h"
 #include "io.h"
-#include "treenode.h"
+#include "kernels.h"
+#include "mpi_io.h"
+#include "parallel.h"
+#include "particles.h"
+#include "profiler.h"
+#include "solver.h"
+#include "trajectory.h"
 
 // namespaces
 using namespace std;
@@ -32,34 +42,108 @@ using namespace std;
 int main(int argc, char** argv) {
     // Local Variables
     struct options_t opts;
-    GLFWwindow* window;
-    double starttime, endtime;
+    GLFWwindow* window = nullptr;
+    double starttime = 0, endtime;
     vector<body> bodies;
 
     // MPI variables
     int mpi_size, mpi_rank;
     int root = 0;
 
-    // Initialize the MPI environment
-    MPI_Init(&argc, &argv);
+    // Initialize the MPI environment.  Only the main thread of a process makes MPI calls.
+    int mpi_thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &mpi_thread_support);
     MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
     MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
 
+    // Times the phases of the run and counts its work, step by step.
+    Profiler profiler;
+
     // Define custom MPI Data Type
-    MPI_Aint displacements[8] = {offsetof(body, index), offsetof(body, x_pos), offsetof(body, y_pos), offsetof(body, mass), offsetof(body, x_vel), offsetof(body, y_vel), offsetof(body, F_x), offsetof(body, F_y)};
-    int block_lengths[8] = {1, 1, 1, 1, 1, 1, 1, 1};
-    MPI_Datatype types[8] = {MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
+    MPI_Aint displacements[9] = {offsetof(body, index), offsetof(body, cost), offsetof(body, x_pos), offsetof(body, y_pos), offsetof(body, mass), offsetof(body, x_vel), offsetof(body, y_vel), offsetof(body, F_x), offsetof(body, F_y)};
+    int block_lengths[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+    MPI_Datatype types[9] = {MPI_INT, MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
     MPI_Datatype custom_body_dt;
-    MPI_Type_create_struct(8, block_lengths, displacements, types, &custom_body_dt);
+    MPI_Type_create_struct(9, block_lengths, displacements, types, &custom_body_dt);
     MPI_Type_commit(&custom_body_dt);
 
+    // Fields of a body that change during a step, sent in place within the bodies vector.  The extent stays the body's, so counts and displacements are still in bodies.
+    MPI_Aint update_displacements[6] = {offsetof(body, cost), offsetof(body, x_pos), offsetof(body, y_pos), offsetof(body, mass), offsetof(body, x_vel), offsetof(body, y_vel)};
+    int update_block_lengths[6] = {1, 1, 1, 1, 1, 1};
+    MPI_Datatype update_types[6] = {MPI_INT, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE, MPI_DOUBLE};
+    MPI_Datatype custom_update_struct_dt, custom_update_dt;
+    MPI_Type_create_struct(6, update_block_lengths, update_displacements, update_types, &custom_update_struct_dt);
+    MPI_Type_create_resized(custom_update_struct_dt, 0, sizeof(body), &custom_update_dt);
+    MPI_Type_commit(&custom_update_dt);
+    MPI_Type_free(&custom_update_struct_dt);
+
+    // A body_update, for exchanging positions as floats.
+    MPI_Aint float_update_displacements[4] = {offsetof(body_update, x_pos), offsetof(body_update, cost), offsetof(body_update, x_vel), offsetof(body_update, mass)};
+    int float_update_block_lengths[4] = {2, 1, 2, 1};
+    MPI_Datatype float_update_types[4] = {MPI_FLOAT, MPI_INT, MPI_DOUBLE, MPI_DOUBLE};
+    MPI_Datatype custom_float_update_dt;
+    MPI_Type_create_struct(4, float_update_block_lengths, float_update_displacements, float_update_types, &custom_float_update_dt);
+    MPI_Type_commit(&custom_float_update_dt);
+
     // printf("main: mpi-process rank(%d) and size(%d)\n", mpi_rank, mpi_size);  // debug statement
 
     // Parse args
     get_opts(argc, argv, &opts);
 
+    // A single process owns every body anyway.
+    opts.distributed = opts.distributed && mpi_size > 1;
+
+    // The other solvers need every body on every process, a locally essential tree only has what Barnes-Hut needs.
+    if (opts.distributed && opts.solver != SOLVER_BH) {
+        opts.distributed = false;
+        if (mpi_rank == root) {
+            fprintf(stderr, "main: only the bh solver runs distributed, every process gets every body\n");
+        }
+    }
+
+    // Only the Barnes-Hut traversal uses the tree's quadrupole moments, the other solvers would sum them up for nothing.
+    if (opts.multipole_order >= 2 && opts.solver != SOLVER_BH) {
+        opts.multipole_order = 0;
+        if (mpi_rank == root) {
+            fprintf(stderr, "main: only the bh solver uses quadrupole moments, -M is ignored\n");
+        }
+    }
+
+    // Spread the work of each process across its threads.
+    omp_set_num_threads(max(opts.threads, 1));
+    if (!pinThreads(opts.pin, getNodeLocalRank(MPI_COMM_WORLD), max(opts.threads, 1))) {
+        fprintf(stderr, "main: rank(%d) could not pin its threads to cores\n", mpi_rank);
+    }
+
+    if (!selectForceKernel(opts.simd)) {
+        selectForceKernel("auto");
+        if (mpi_rank == root) {
+            fprintf(stderr, "main: %s force kernel is not supported by this CPU, using %s\n", opts.simd, getForceKernelName());
+        }
+    }
+
     // printf("main: mpi-process rank(%d) and steps(%d)\n", mpi_rank, opts.steps);  // debug statement
 
+    // Continue from the newest checkpoint an earlier run of the same configuration left behind, if there is one.
+    int start_step = 0;
+    unique_ptr<Checkpointer> checkpointer;
+    double checkpoint_time = MPI_Wtime();
+    if (opts.checkpoint_prefix != nullptr && mpi_rank == root) {
+        checkpointer = make_unique<Checkpointer>(opts.checkpoint_prefix, opts);
+        start_step = max(checkpointer->restore(bodies), 0);
+        if (start_step > 0) {
+            opts.records = bodies.size();
+            fprintf(stderr, "main: restarting from the checkpoint of step %d\n", start_step);
+        }
+    }
+    MPI_Bcast(&start_step, 1, MPI_INT, root, MPI_COMM_WORLD);
+
+    // Binary body files are read and written by all processes at once, each process handling only its own block of bodies.
+    // The root decides for everyone, the other processes may not even see a text input file.
+    int collective_input = mpi_size > 1 && mpi_rank == root && start_step == 0 && isBinaryBodyFile(opts.input_filename);
+    MPI_Bcast(&collective_input, 1, MPI_INT, root, MPI_COMM_WORLD);
+    bool collective_output = mpi_size > 1 && hasBinaryExtension(opts.output_filename);
+
     if (mpi_rank == root) {
         /* Window setup */
         if (opts.visualization) {
@@ -89,36 +173,36 @@ int main(int argc, char** argv) {
         starttime = MPI_Wtime();
 
         // Read input data
-        read_file(&opts, bodies);
+        if (!collective_input && start_step == 0) {
+            profiler.start(PHASE_IO);
+            read_file(&opts, bodies);
+            profiler.stop(PHASE_IO);
+        }
 
         // printf("main: rank(%d), bodies: \n", mpi_rank);  // debug statement
         // printBodies(bodies);  // debug statement
 
         // Send number of bodies (records) to be processed by all non-root processes.
-        if (mpi_size != 1) {
+        if (mpi_size != 1 && !collective_input) {
             // auto start = std::chrono::high_resolution_clock::now();
 
             // Send number of records.
             MPI_Bcast(&opts.records, 1, MPI_INT, root, MPI_COMM_WORLD);
 
+            // A distributed run scatters the bodies below instead.
+            if (!opts.distributed) {
+                MPI_Bcast(bodies.data(), opts.records, custom_body_dt, root, MPI_COMM_WORLD);
+            }
+
             /*
             auto end = std::chrono::high_resolution_clock::now();
             auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
             printf("%06ld\n", diff.count());
             */
 
-            // auto start = std::chrono::high_resolution_clock::now();
-
-            MPI_Bcast(bodies.data(), opts.records, custom_body_dt, root, MPI_COMM_WORLD);
             // printf("main: rank(%d): broadcast data \n", mpi_rank);  // debug statement
-
-            /*
-            auto end = std::chrono::high_resolution_clock::now();
-            auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-            printf("%06ld\n", diff.count());
-            */
         }
-    } else {
+    } else if (!collective_input) {
         //auto start = std::chrono::high_resolution_clock::now();
 
         // Non-root processes receive bodies
@@ -131,12 +215,14 @@ int main(int argc, char** argv) {
         printf("%06ld\n", diff.count());
         */
 
-        bodies.resize(opts.records);
         // printf("main: rank(%d): bodies capacity (%d) \n", mpi_rank, (int)bodies.capacity());  // debug statement
 
         //auto start = std::chrono::high_resolution_clock::now();
 
-        MPI_Bcast(bodies.data(), opts.records, custom_body_dt, root, MPI_COMM_WORLD);
+        if (!opts.distributed) {
+            bodies.resize(opts.records);
+            MPI_Bcast(bodies.data(), opts.records, custom_body_dt, root, MPI_COMM_WORLD);
+        }
         // printf("main: rank(%d): received bodies with size (%d) \n", mpi_rank, (int)bodies.size());  // debug statement
         // printf("main: rank(%d), bodies: \n", mpi_rank);  // debug statement
         // printBodies(bodies);  // debug statement
@@ -153,20 +239,145 @@ int main(int argc, char** argv) {
     // printf("main: bodies: \n");  // debug statement
     // printBodies(bodies);         // debug statement
 
+    // Splits the bodies of a distributed run across processes.  Each process keeps only the bodies it owns.
+    Decomposition decomposition(MPI_COMM_WORLD, custom_body_dt, opts.balance);
+    if (collective_input) {
+        profiler.start(PHASE_IO);
+        readBodiesCollective(opts.input_filename, MPI_COMM_WORLD, custom_body_dt, !opts.distributed, bodies, &opts.records);
+        profiler.stop(PHASE_IO);
+    } else if (opts.distributed) {
+        vector<body> local_bodies;
+        decomposition.scatter(bodies, local_bodies, opts.records, root);
+        bodies.swap(local_bodies);
+
+        double sent, received;
+        decomposition.getTraffic(&sent, &received);
+        profiler.add(COUNTER_BYTES_SENT, sent);
+        profiler.add(COUNTER_BYTES_RECEIVED, received);
+    }
+
+    // Tree of the bodies a process of a distributed run owns, and the sources its Barnes-Hut Tree is built from: its own bodies plus the pseudo-particles and bodies other processes sent it.
+    BHTree local_tree(opts.leaf_size, 4, opts.opening);
+    vector<body> sources;
+
+    // Every body of a distributed run, gathered by the root for the visualization and the output.
+    vector<body> all_bodies;
+
     int bodies_size = bodies.size();  // size of the bodies vector.
     // int bodies_size = opts.records;  // size of the bodies vector.
     // printf("main: rank(%d) bodies.size: %d \n", mpi_rank, bodies_size);  // debug statement
 
-    for (int i = 0; i < opts.steps; ++i) {
-        // Create root node for Barnes-Hut Tree
-        unique_ptr<TreeNode> bhtree_root(new TreeNode(0, 4));
+    // Barnes-Hut Tree whose node pool is reused by every step.
+    BHTree bhtree(opts.leaf_size, 4, opts.opening, opts.multipole_order);
+
+    // Calculates the net forces from the tree every step.
+    unique_ptr<ForceSolver> solver = createForceSolver(opts, bhtree);
+
+    // Structure of arrays copy of the bodies for the force and integration loops.
+    ParticleStore particles;
 
+    // Changed state of the bodies, exchanged by replicated runs with float positions.
+    vector<body_update> updates;
+
+    // Snapshots of the positions, appended to the trajectory file by a background thread of the root.
+    unique_ptr<TrajectoryWriter> trajectory;
+    string trajectory_filename = (opts.trajectory_filename != nullptr) ? opts.trajectory_filename : string(opts.output_filename) + ".trj";
+    if (opts.snapshot_every > 0 && mpi_rank == root) {
+        trajectory = make_unique<TrajectoryWriter>(trajectory_filename.c_str(), opts.records, start_step);
+    }
+
+    // Kick-drift-kick ends with an extra step that only closes the last step's kick.
+    int steps = (opts.integrator == INTEGRATOR_KDK) ? opts.steps + 1 : opts.steps;
+
+    for (int i = start_step; i < steps; ++i) {
         //auto start = std::chrono::high_resolution_clock::now();
+        profiler.beginStep(i);
+
+        if (opts.distributed) {
+            profiler.start(PHASE_DECOMPOSITION);
+
+            // Bodies that moved out of the process's range of the Z-curve go to their new owner.
+            decomposition.partition(bodies);
+            bodies_size = bodies.size();
+
+            // Build the tree of the process's own bodies, which are already in Z-curve order, and trade the parts of it other processes need for theirs.
+            local_tree.buildMorton(bodies);
+            local_tree.flatten();
+            decomposition.exchangeEssentialTrees(local_tree, bodies, opts.theta, sources);
 
-        // Insert bodies into Barnes-Hut Tree
-        for (int j = 0; j < bodies_size; ++j) {
-            // printf("main: insert body \n");  // debug statement
-            bhtree_root->insertBody(bodies[j]);
+            profiler.stop(PHASE_DECOMPOSITION);
+        }
+
+        // A distributed run builds the tree from the sources, while the forces are still calculated for the process's own bodies.
+        vector<body>& tree_bodies = opts.distributed ? sources : bodies;
+
+        // A replicated run can share the build, every process has every body.
+        bool shared_build = opts.tree_build == TREE_BUILD_SHARED && !opts.distributed && mpi_size > 1;
+
+        profiler.start(PHASE_TREE_BUILD);
+        if (shared_build) {
+            // Every process builds its share of the subtrees and the processes trade them already flattened.
+            bhtree.buildMortonShared(tree_bodies, MPI_COMM_WORLD);
+
+            double sent, received;
+            bhtree.getTraffic(&sent, &received);
+            profiler.add(COUNTER_BYTES_SENT, sent);
+            profiler.add(COUNTER_BYTES_RECEIVED, received);
+        } else if (opts.tree_build == TREE_BUILD_UPDATE && !opts.distributed) {
+            // Keep last step's tree and only move the bodies that left their leaf.  The sources of a distributed run are new every step.
+            bhtree.updateMorton(tree_bodies, opts.rebuild_threshold);
+        } else if (opts.tree_build != TREE_BUILD_INSERT) {
+            // Sort bodies along the Z-curve and build the Barnes-Hut Tree from the sorted keys.  Every process sorts the same bodies the same way, so the bodies vector stays identical across processes.
+            bhtree.buildMorton(tree_bodies);
+        } else {
+            // Reset the Barnes-Hut Tree to an empty root node
+            bhtree.reset(tree_bodies);
+
+            // Insert bodies into Barnes-Hut Tree
+            int tree_bodies_size = tree_bodies.size();
+            for (int j = 0; j < tree_bodies_size; ++j) {
+                // printf("main: insert body \n");  // debug statement
+                bhtree.insertBody(j);
+            }
+
+            // Sum up the centers of mass once, instead of on every level of every insertion
+            bhtree.calculateCenterOfMass();
+        }
+
+        profiler.stop(PHASE_TREE_BUILD);
+
+        // Lay the Barnes-Hut Tree out for the force calculation
+        profiler.start(PHASE_FLATTEN);
+        if (!shared_build) {
+            bhtree.flatten();
+        }
+        particles.load(bodies);
+        profiler.stop(PHASE_FLATTEN);
+
+        if (opts.verify_tree && i == 0 && opts.tree_build != TREE_BUILD_INSERT) {
+            // Rebuild the first step's tree with a single thread and check the threads, or the processes, built the same tree.
+            vector<body> reference_bodies = tree_bodies;
+            BHTree reference_tree(opts.leaf_size, 4, opts.opening, opts.multipole_order);
+            reference_tree.buildMorton(reference_bodies, false);
+            reference_tree.flatten();
+
+            // Inserting the sorted bodies into TreeNodes one by one has to build the same tree as well.
+            BHTree insert_tree(opts.leaf_size, 4, opts.opening, opts.multipole_order);
+            insert_tree.reset(reference_bodies);
+            int reference_bodies_size = reference_bodies.size();
+            for (int j = 0; j < reference_bodies_size; ++j) {
+                insert_tree.insertBody(j);
+            }
+            insert_tree.calculateCenterOfMass();
+            insert_tree.flatten();
+
+            if (!bhtree.isEquivalent(reference_tree)) {
+                fprintf(stderr, "main: rank(%d): parallel tree build differs from the sequential build\n", mpi_rank);
+            } else if (!insert_tree.isEquivalent(reference_tree)) {
+                fprintf(stderr, "main: rank(%d): sequential tree build differs from the TreeNode insert build\n", mpi_rank);
+            } else if (mpi_rank == root) {
+                fprintf(stderr, "main: parallel tree build matches the sequential and the TreeNode insert builds\n");
+            }
         }
 
         /*
@@ -175,27 +386,26 @@ int main(int argc, char** argv) {
         printf("%06ld\n", diff.count());
         */
 
-        if (mpi_size == 1) {
-            //auto start = std::chrono::high_resolution_clock::now();
-            
-            // Calculate net force on bodies.
-            for (int j = 0; j < bodies_size; ++j) {
-                bodies[j].resetForce();
-                bhtree_root->calculateNetForce(bodies[j], opts.theta);
-            }
+        // Bodies this process calculates the net force of.
+        int work_begin = 0, work_end = bodies_size;
 
-            /*
-            auto end = std::chrono::high_resolution_clock::now();
-            auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-            printf("%06ld\n", diff.count());
-            */
+        IntegrationStep step = IntegrationStep::get(opts.integrator, opts.dt, i, opts.steps);
+
+        profiler.start(PHASE_PREPARE);
+        profiler.add(COUNTER_NODE_VISITS, solver->prepare(particles));
+        profiler.stop(PHASE_PREPARE);
 
+        if (mpi_size == 1 || opts.distributed) {
             //auto start = std::chrono::high_resolution_clock::now();
+            
+            // Calculate net force on bodies and their new positions in the same pass.
+            profiler.start(PHASE_FORCE);
+            profiler.add(COUNTER_NODE_VISITS, solver->calculateNetForces(particles, 0, bodies_size, &step));
+            profiler.stop(PHASE_FORCE);
 
-            // Calculate bodies new positions using Leap Frog Vertlet Integration
-            for (int j = 0; j < bodies_size; ++j) {
-                bodies[j].calculateLeapFrogVertletIntegration(opts.dt);
-            }
+            profiler.start(PHASE_STORE);
+            particles.store(bodies, 0, bodies_size);
+            profiler.stop(PHASE_STORE);
 
             /*
             auto end = std::chrono::high_resolution_clock::now();
@@ -204,32 +414,12 @@ int main(int argc, char** argv) {
             */
 
         } else {  // multi-processor / non-sequential logic
-            // Decompose the bodies for each processes to be responsible for.
-            int bodies_per_process = bodies_size / mpi_size;
-            int bodies_for_last_process;
-            int last_rank = mpi_size - 1;
-
-            if (bodies_per_process == 0) {
-                bodies_per_process = 1;
-                bodies_for_last_process = 1;
-                last_rank = bodies_size - 1;
-            } else {
-                bodies_for_last_process = (bodies_size - (bodies_per_process * mpi_size)) + bodies_per_process;
-            }
-
-            // potential to improve with a unique pointer and allocate on stack.  This array may get too large for the stack.
-            // int* recvcount = new int[last_rank + 1]{0};
-            // int* displacements = new int[last_rank + 1]{0};
-            int recvcount[last_rank + 1] = {0};
-            int displacements[last_rank + 1] = {0};
-            for (int j = 0; j < last_rank + 1; ++j) {
-                displacements[j] = j * bodies_per_process;
-                if (j == last_rank) {
-                    recvcount[j] = bodies_for_last_process;
-                } else {
-                    recvcount[j] = bodies_per_process;
-                }
-            }
+            // Decompose the bodies for each processes to be responsible for.  Every process gets a range of consecutive bodies, split by the work of their last net force.
+            int recvcount[mpi_size];
+            int displacements[mpi_size];
+            splitWork(bodies, opts.balance, mpi_size, recvcount, displacements);
+            work_begin = displacements[mpi_rank];
+            work_end = work_begin + recvcount[mpi_rank];
 
             /*
             if (mpi_rank == root and i == opts.records - 1) {
@@ -247,86 +437,165 @@ int main(int argc, char** argv) {
             }
             */
 
-            if (mpi_rank <= last_rank) {
-                // All process's calculated net force for their responsible bodies are all gather to root processor
-                for (int p = 0; p < last_rank + 1; ++p) {
-                    if (mpi_rank == p) {
-                        int start_index = displacements[p];
-                        int end_index = start_index + recvcount[p];
-
-                        for (int j = start_index; j < end_index; ++j) {
-                            bodies[j].resetForce();
-                            bhtree_root->calculateNetForce(bodies[j], opts.theta);
-                        }
-
-                        // printf("main: rank(%d), bodies: \n", mpi_rank);  // debug statement
-                        // printBodies(bodies, mpi_rank);  // debug statement
-
-                        // int number_of_elements = end_index - start_index;
-                        // printf("main: rank(%d), start_index(%d), end_index(%d), number_of_elements(%d) \n", mpi_rank, start_index, end_index, number_of_elements);  // debug statement
-
-                        //auto start = std::chrono::high_resolution_clock::now();
-
-                        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bodies.data(), recvcount, displacements, custom_body_dt, MPI_COMM_WORLD);
-
-                        /*
-                        auto end = std::chrono::high_resolution_clock::now();
-                        auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-                        printf("%06ld\n", diff.count());
-                        */
-
-                        // printf("main: rank(%d), complete allgatherv \n", mpi_rank);  // debug statement
-
-                        // printf("main: rank(%d): received bodies with size (%d) \n", mpi_rank, (int)bodies.size());  // debug statement
-
-                        // printf("main: rank(%d), bodies: \n", mpi_rank);  // debug statement
-                        // printBodies(bodies, mpi_rank);  // debug statement
-                    }
+            /*  Every process calculates and integrates its bodies chunk by chunk and shares each chunk with a non-blocking
+                all gather as soon as it is done, so the exchange of one chunk overlaps the work on the next.  A single
+                exchange per step carries only the fields the step changed: position, velocity, cost and the mass of lost
+                bodies.  The other processes' bodies are not read during the step, the forces come from the flattened
+                tree's copies of their positions.  With float positions the bodies are exchanged as body_updates, and the
+                owner rounds its own positions as well so every process keeps the same bodies.
+            */
+            int chunks = max(opts.chunks, 1);
+            if (opts.float_positions) {
+                updates.resize(bodies_size);
+            }
+            vector<int> chunk_counts(chunks * mpi_size);
+            vector<int> chunk_displacements(chunks * mpi_size);
+            vector<MPI_Request> requests(chunks);
+            splitChunks(recvcount, displacements, mpi_size, chunks, opts.group_size, chunk_counts.data(), chunk_displacements.data());
+
+            for (int c = 0; c < chunks; ++c) {
+                int start_index = chunk_displacements[c * mpi_size + mpi_rank];
+                int end_index = start_index + chunk_counts[c * mpi_size + mpi_rank];
+
+                profiler.start(PHASE_FORCE);
+                profiler.add(COUNTER_NODE_VISITS, solver->calculateNetForces(particles, start_index, end_index, &step));
+                profiler.stop(PHASE_FORCE);
+
+                profiler.start(PHASE_STORE);
+                if (opts.float_positions) {
+                    particles.roundPositions(start_index, end_index);
+                    particles.storeUpdates(updates, start_index, end_index);
                 }
+                particles.store(bodies, start_index, end_index);
+                profiler.stop(PHASE_STORE);
 
-                for (int p = 0; p < last_rank + 1; ++p) {
-                    if (mpi_rank == p) {
-                        int start_index = displacements[p];
-                        int end_index = start_index + recvcount[p];
-
-                        for (int j = start_index; j < end_index; ++j) {
-                            bodies[j].calculateLeapFrogVertletIntegration(opts.dt);
-                        }
-
-                        //auto start = std::chrono::high_resolution_clock::now();
+                profiler.start(PHASE_COMMUNICATION);
+                if (opts.float_positions) {
+                    MPI_Iallgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, updates.data(), &chunk_counts[c * mpi_size], &chunk_displacements[c * mpi_size], custom_float_update_dt, MPI_COMM_WORLD, &requests[c]);
+                } else {
+                    MPI_Iallgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bodies.data(), &chunk_counts[c * mpi_size], &chunk_displacements[c * mpi_size], custom_update_dt, MPI_COMM_WORLD, &requests[c]);
+                }
 
-                        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bodies.data(), recvcount, displacements, custom_body_dt, MPI_COMM_WORLD);
+                // Only the main thread makes MPI calls, so give the chunks in flight a chance to progress.
+                int done;
+                MPI_Testall(c + 1, requests.data(), &done, MPI_STATUSES_IGNORE);
+                profiler.stop(PHASE_COMMUNICATION);
+            }
 
-                        /*
-                        auto end = std::chrono::high_resolution_clock::now();
-                        auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-                        printf("%06ld\n", diff.count());
-                        */
+            profiler.start(PHASE_COMMUNICATION);
+            MPI_Waitall(chunks, requests.data(), MPI_STATUSES_IGNORE);
+            profiler.stop(PHASE_COMMUNICATION);
+
+            // Every process sends its range to every other process and receives all the others.
+            int update_size;
+            MPI_Type_size(opts.float_positions ? custom_float_update_dt : custom_update_dt, &update_size);
+            profiler.add(COUNTER_BYTES_SENT, static_cast<double>(recvcount[mpi_rank]) * update_size * (mpi_size - 1));
+            profiler.add(COUNTER_BYTES_RECEIVED, static_cast<double>(bodies_size - recvcount[mpi_rank]) * update_size);
+
+            if (opts.float_positions) {
+                profiler.start(PHASE_STORE);
+                #pragma omp parallel for schedule(static)
+                for (int j = 0; j < bodies_size; ++j) {
+                    if (j < work_begin || j >= work_end) {
+                        bodies[j].applyUpdate(updates[j]);
                     }
                 }
+                profiler.stop(PHASE_STORE);
             }
 
             // delete[] displacements;
             // delete[] recvcount;
         }
 
+        // A particle's cost counts the entry that holds its own body, which the tree, or the sources, always have exactly one of.
+        long interactions = 0;
+        #pragma omp parallel for schedule(static) reduction(+ : interactions)
+        for (int j = work_begin; j < work_end; ++j) {
+            if (particles.cost[j] > 0) {
+                interactions += particles.cost[j] - 1;
+            }
+        }
+        profiler.add(COUNTER_INTERACTIONS, interactions);
+
+        if (opts.log_imbalance) {
+            double work = 0;
+            for (int j = work_begin; j < work_end; ++j) {
+                work += getBodyWork(bodies[j], BALANCE_COST);
+            }
+            double imbalance = calculateImbalance(work, MPI_COMM_WORLD);
+            if (mpi_rank == root) {
+                fprintf(stderr, "main: step(%d) imbalance: %.3f\n", i, imbalance);
+            }
+        }
+
+        // The root of a distributed run only has its own bodies, so every process sends it theirs to draw.
+        if (opts.visualization && opts.distributed) {
+            decomposition.gather(bodies, all_bodies, root);
+        }
+
         if (opts.visualization && mpi_rank == root) {
+            vector<body>& drawn_bodies = opts.distributed ? all_bodies : bodies;
+            int drawn_bodies_size = drawn_bodies.size();
             glClear(GL_COLOR_BUFFER_BIT);
-            drawQuadTreeBounds2D(*bhtree_root);
+            drawQuadTreeBounds2D(bhtree, bhtree.getRoot());
             float colors[3] = {1.0f, 0.2f, 0.2f};
-            for (int p = 0; p < bodies_size; p++) {
-                colors[0] = bodies[p].mass / 4;
-                drawParticle2D(getWindowPoint(bodies[p].x_pos), getWindowPoint(bodies[p].y_pos), 0.01, colors);
+            for (int p = 0; p < drawn_bodies_size; p++) {
+                colors[0] = drawn_bodies[p].mass / 4;
+                drawParticle2D(getWindowPoint(drawn_bodies[p].x_pos), getWindowPoint(drawn_bodies[p].y_pos), 0.01, colors);
             }
             //  Swap buffers
             glfwSwapBuffers(window);
             glfwPollEvents();
         }
 
+        // The closing half kick of kdk moves no body and leaves the velocities synchronized, which a restarted step would not expect.
+        int checkpoint_due = 0;
+        if (opts.checkpoint_prefix != nullptr && (opts.checkpoint_every > 0 || opts.checkpoint_seconds > 0) && i < opts.steps) {
+            // Only the root keeps time, so it tells everyone when a checkpoint is due.
+            checkpoint_due = opts.checkpoint_every > 0 && (i + 1) % opts.checkpoint_every == 0;
+            if (opts.checkpoint_seconds > 0) {
+                checkpoint_due = checkpoint_due || (mpi_rank == root && MPI_Wtime() - checkpoint_time >= opts.checkpoint_seconds);
+                MPI_Bcast(&checkpoint_due, 1, MPI_INT, root, MPI_COMM_WORLD);
+            }
+        }
+        bool snapshot_due = opts.snapshot_every > 0 && (i + 1) % opts.snapshot_every == 0 && i < opts.steps;
+
+        if (checkpoint_due || snapshot_due) {
+            profiler.start(PHASE_IO);
+            if (opts.distributed) {
+                decomposition.gather(bodies, all_bodies, root);
+            }
+
+            // The root only copies the bodies, background threads write them while the next steps run.
+            if (mpi_rank == root) {
+                vector<body>& saved_bodies = opts.distributed ? all_bodies : bodies;
+                if (snapshot_due) {
+                    trajectory->push(saved_bodies, i + 1, opts.dt);
+                }
+                if (checkpoint_due) {
+                    // A restart keeps the snapshots up to the checkpoint's step, so they have to be in the file before it is.
+                    if (trajectory) {
+                        trajectory->flush();
+                    }
+                    checkpointer->write(saved_bodies, i + 1);
+                    checkpoint_time = MPI_Wtime();
+                }
+            }
+            profiler.stop(PHASE_IO);
+        }
+
+        if (opts.distributed) {
+            double sent, received;
+            decomposition.getTraffic(&sent, &received);
+            profiler.add(COUNTER_BYTES_SENT, sent);
+            profiler.add(COUNTER_BYTES_RECEIVED, received);
+        }
+        profiler.endStep();
+
         /*
         if (i == opts.steps - 1 && mpi_rank == root) {
             printf("main: print Barnes-Hut Tree \n");  // debug statement
-            bhtree_root->printTree();                  // debug statement
+            bhtree.printTree();                  // debug statement
         }
         */
     }
@@ -340,11 +609,29 @@ int main(int argc, char** argv) {
 
     MPI_Barrier(MPI_COMM_WORLD);  // barrier used to make sure all processors are synced before taking a time measurement.
 
+    profiler.start(PHASE_IO);
+    if (collective_output) {
+        // Every process of a replicated run has every body, so each one writes its block of them.
+        int write_begin = 0, write_end = bodies.size();
+        if (!opts.distributed) {
+            getBodyBlock(bodies.size(), mpi_size, mpi_rank, &write_begin, &write_end);
+        }
+        writeBodiesCollective(opts.output_filename, MPI_COMM_WORLD, bodies, write_begin, write_end);
+    } else if (opts.distributed) {
+        decomposition.gather(bodies, all_bodies, root);
+        bodies.swap(all_bodies);
+    }
+    profiler.stop(PHASE_IO);
+
     if (mpi_rank == root) {
         // printf("main: rank(%d), bodies: \n", mpi_rank);  // debug statement
         // printBodies(bodies, mpi_rank);                   // debug statement
 
-        write_file(&opts, bodies);
+        if (!collective_output) {
+            profiler.start(PHASE_IO);
+            write_file(&opts, bodies);
+            profiler.stop(PHASE_IO);
+        }
 
         if (opts.visualization) {
             // Loop until the user closes the window
@@ -362,7 +649,26 @@ int main(int argc, char** argv) {
         printf("%06.0f\n", endtime - starttime);
     }
 
+    if (checkpointer) {
+        checkpointer->wait();
+    }
+    if (trajectory) {
+        trajectory->close();
+    }
+
+    if (opts.profile_filename != nullptr) {
+        if (opts.distributed) {
+            double sent, received;
+            decomposition.getTraffic(&sent, &received);
+            profiler.add(COUNTER_BYTES_SENT, sent);
+            profiler.add(COUNTER_BYTES_RECEIVED, received);
+        }
+        profiler.write(opts.profile_filename, MPI_COMM_WORLD, root);
+    }
+
     MPI_Type_free(&custom_body_dt);
+    MPI_Type_free(&custom_update_dt);
+    MPI_Type_free(&custom_float_update_dt);
 
     MPI_Finalize();
 
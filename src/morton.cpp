@@ -0,0 +1,68 @@
+#include "morton.h"
+
+// Spreads the lower 32 bits of value so that there is a 0 bit between each of them.
+static uint64_t spreadBits(uint64_t value) {
+    value &= 0x00000000FFFFFFFFull;
+    value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+    value = (value | (value << 8)) & 0x00FF00FF00FF00FFull;
+    value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    value = (value | (value << 2)) & 0x3333333333333333ull;
+    value = (value | (value << 1)) & 0x5555555555555555ull;
+    return value;
+}
+
+// Quantizes a coordinate of the space to a MORTON_BITS bit cell number.
+static uint64_t quantize(double point, double space_length) {
+    const double cells = static_cast<double>(1u << MORTON_BITS);
+    double cell = point / space_length * cells;
+
+    if (cell < 0) {
+        return 0;
+    }
+    if (cell >= cells) {
+        return (1u << MORTON_BITS) - 1;
+    }
+    return static_cast<uint64_t>(cell);
+}
+
+uint64_t calculateMortonKey(double x, double y, double space_length) {
+    return (spreadBits(quantize(y, space_length)) << 1) | spreadBits(quantize(x, space_length));
+}
+
+int getMortonQuadrant(uint64_t key, int level) {
+    return static_cast<int>((key >> (2 * (MORTON_BITS - level))) & 3);
+}
+
+void radixSortKeys(vector<uint64_t>& keys, vector<int>& order, vector<uint64_t>& keys_buffer, vector<int>& order_buffer) {
+    int keys_size = keys.size();
+    keys_buffer.resize(keys_size);
+    order_buffer.resize(keys_size);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        int counts[256] = {0};
+        for (int i = 0; i < keys_size; ++i) {
+            ++counts[(keys[i] >> shift) & 0xFF];
+        }
+
+        // Skip the pass when every key has the same digit, which is the case for the unused top bits.
+        if (keys_size == 0 || counts[(keys[0] >> shift) & 0xFF] == keys_size) {
+            continue;
+        }
+
+        int offset = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            int count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+
+        for (int i = 0; i < keys_size; ++i) {
+            int position = counts[(keys[i] >> shift) & 0xFF]++;
+            keys_buffer[position] = keys[i];
+            order_buffer[position] = order[i];
+        }
+
+        keys.swap(keys_buffer);
+        order.swap(order_buffer);
+    }
+}
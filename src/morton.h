@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Number of bits per axis in a Morton key.  It is also the deepest level a Morton-built tree can reach.
+const int MORTON_BITS = 30;
+
+// Morton key given to lost bodies so that they sort after every body that is still in the simulation.
+const uint64_t LOST_MORTON_KEY = UINT64_MAX;
+
+/*  Calculates the Morton (Z-curve) key of a point in a square space of space_length, starting at the origin.
+    The x and y coordinates are quantized to MORTON_BITS bits each and interleaved so that every 2 bits from the
+    top select one of the four quadrants of the next tree level: (y bit << 1) | x bit, i.e. SW, SE, NW, NE.
+*/
+uint64_t calculateMortonKey(double x, double y, double space_length);
+
+// Returns the 2 bit quadrant code of a Morton key at a tree level (the root's children are level 1).
+int getMortonQuadrant(uint64_t key, int level);
+
+/*  Sorts keys in ascending order with a least significant digit radix sort, 8 bits per pass, and applies the
+    same permutation to order.  The sort is stable.  keys_buffer and order_buffer are scratch space that is
+    reused between calls.
+*/
+void radixSortKeys(vector<uint64_t>& keys, vector<int>& order, vector<uint64_t>& keys_buffer, vector<int>& order_buffer);
@@ -0,0 +1,118 @@
+#include "mpi_io.h"
+
+#include <cstdint>
+#include <iostream>
+
+// Custom Libraries
+#include "io.h"
+
+void getBodyBlock(int records, int comm_size, int rank, int* begin, int* end) {
+    int bodies_per_process = records / comm_size;
+    *begin = rank * bodies_per_process;
+    *end = (rank == comm_size - 1) ? records : *begin + bodies_per_process;
+}
+
+void readBodiesCollective(const char* filename, MPI_Comm comm, MPI_Datatype body_dt, bool all_bodies, vector<body>& bodies, int* records) {
+    int comm_size, comm_rank;
+    MPI_Comm_size(comm, &comm_size);
+    MPI_Comm_rank(comm, &comm_rank);
+
+    MPI_File file;
+    if (MPI_File_open(comm, filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (comm_rank == 0) {
+            std::cerr << "mpi_io: cannot open " << filename << "." << std::endl;
+        }
+        MPI_Abort(comm, 1);
+    }
+
+    body_file_header header;
+    MPI_Offset file_size;
+    MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    MPI_File_get_size(file, &file_size);
+
+    // Every process read the same header, so the root checks it alone and the error is only printed once.
+    int valid = (comm_rank == 0) ? checkBodyFileHeader(header, file_size, filename) : 0;
+    MPI_Bcast(&valid, 1, MPI_INT, 0, comm);
+    if (!valid) {
+        MPI_Abort(comm, 1);
+    }
+
+    *records = header.count;
+    int begin, end;
+    getBodyBlock(*records, comm_size, comm_rank, &begin, &end);
+    int count = end - begin;
+
+    // Every column is read with its own collective call, so the processes' blocks of it form one contiguous request.
+    vector<int32_t> indices(count);
+    MPI_File_read_at_all(file, getBodyFileColumnOffset(header, 0) + begin * sizeof(int32_t), indices.data(), count, MPI_INT32_T, MPI_STATUS_IGNORE);
+
+    vector<double> columns[5];
+    for (int column = 1; column < BODY_FILE_COLUMN_COUNT; ++column) {
+        columns[column - 1].resize(count);
+        MPI_File_read_at_all(file, getBodyFileColumnOffset(header, column) + begin * sizeof(double), columns[column - 1].data(), count, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    }
+
+    MPI_File_close(&file);
+
+    bodies.resize(all_bodies ? *records : count);
+    int offset = all_bodies ? begin : 0;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < count; ++i) {
+        bodies[offset + i] = body(indices[i], columns[0][i], columns[1][i], columns[2][i], columns[3][i], columns[4][i]);
+    }
+
+    if (all_bodies) {
+        vector<int> counts(comm_size), displacements(comm_size);
+        for (int p = 0; p < comm_size; ++p) {
+            int p_end;
+            getBodyBlock(*records, comm_size, p, &displacements[p], &p_end);
+            counts[p] = p_end - displacements[p];
+        }
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, bodies.data(), counts.data(), displacements.data(), body_dt, comm);
+    }
+}
+
+void writeBodiesCollective(const char* filename, MPI_Comm comm, vector<body>& bodies, int begin, int end) {
+    int comm_rank;
+    MPI_Comm_rank(comm, &comm_rank);
+
+    // Position of the process's bodies in the file and the number of bodies in it.
+    long count = end - begin;
+    long first = 0, records = 0;
+    MPI_Exscan(&count, &first, 1, MPI_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&count, &records, 1, MPI_LONG, MPI_SUM, comm);
+    if (comm_rank == 0) {
+        first = 0;
+    }
+
+    MPI_File file;
+    if (MPI_File_open(comm, filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (comm_rank == 0) {
+            std::cerr << "mpi_io: cannot open " << filename << "." << std::endl;
+        }
+        MPI_Abort(comm, 1);
+    }
+    MPI_File_set_size(file, 0);
+
+    body_file_header header = createBodyFileHeader(records);
+    if (comm_rank == 0) {
+        MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    vector<int32_t> indices(count);
+    for (int i = 0; i < count; ++i) {
+        indices[i] = bodies[begin + i].index;
+    }
+    MPI_File_write_at_all(file, getBodyFileColumnOffset(header, 0) + first * sizeof(int32_t), indices.data(), count, MPI_INT32_T, MPI_STATUS_IGNORE);
+
+    vector<double> column(count);
+    double body::*fields[5] = {&body::x_pos, &body::y_pos, &body::mass, &body::x_vel, &body::y_vel};
+    for (int c = 0; c < 5; ++c) {
+        for (int i = 0; i < count; ++i) {
+            column[i] = bodies[begin + i].*fields[c];
+        }
+        MPI_File_write_at_all(file, getBodyFileColumnOffset(header, c + 1) + first * sizeof(double), column.data(), count, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    }
+
+    MPI_File_close(&file);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <vector>
+
+// Custom Libraries
+#include "body.h"
+
+using namespace std;
+
+// Returns the block [begin, end) of records bodies that rank reads or writes out of comm_size processes.  The last process takes the remainder.
+void getBodyBlock(int records, int comm_size, int rank, int* begin, int* end);
+
+/*  Reads a binary body file collectively with MPI-IO.  Every process of comm reads only its own block of every column
+    (see getBodyBlock()) into bodies and the number of bodies in the file into records.  With all_bodies set, the blocks
+    are then all gathered as body_dt so every process has every body.  Aborts all processes if the file cannot be read.
+*/
+void readBodiesCollective(const char* filename, MPI_Comm comm, MPI_Datatype body_dt, bool all_bodies, vector<body>& bodies, int* records);
+
+/*  Writes a binary body file collectively with MPI-IO.  Every process of comm writes its bodies in [begin, end), and
+    the file holds the ranges of all processes in rank order.
+*/
+void writeBodiesCollective(const char* filename, MPI_Comm comm, vector<body>& bodies, int begin, int end);
@@ -0,0 +1,118 @@
+#include "parallel.h"
+
+#include <omp.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <vector>
+
+// namespaces
+using namespace std;
+
+int getNodeLocalRank(MPI_Comm comm) {
+    MPI_Comm node_comm;
+    int local_rank;
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+    MPI_Comm_rank(node_comm, &local_rank);
+    MPI_Comm_free(&node_comm);
+
+    return local_rank;
+}
+
+bool pinThreads(pin_t pin, int local_rank, int threads) {
+    if (pin == PIN_NONE) {
+        return true;
+    }
+
+    // Cores the process was started with.  Launchers bind processes to a single core by default, so hybrid runs should be started with e.g. mpirun --bind-to none to hand every process all of the node's cores.
+    cpu_set_t available;
+    if (sched_getaffinity(0, sizeof(available), &available) != 0) {
+        return false;
+    }
+
+    vector<int> cores;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &available)) {
+            cores.push_back(cpu);
+        }
+    }
+    int cores_size = cores.size();
+    int first_core = local_rank * threads;
+
+    // Every thread sets its own affinity, so threads the OpenMP runtime already started are pinned as well.
+    bool pinned = true;
+    #pragma omp parallel num_threads(threads) reduction(&& : pinned)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if (pin == PIN_THREAD) {
+            CPU_SET(cores[(first_core + omp_get_thread_num()) % cores_size], &cpu_set);
+        } else {
+            for (int t = 0; t < threads; ++t) {
+                CPU_SET(cores[(first_core + t) % cores_size], &cpu_set);
+            }
+        }
+        pinned = sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+    }
+
+    return pinned;
+}
+
+double getBodyWork(body& body, balance_t balance) {
+    if (body.mass == -1) {
+        return 0;
+    }
+    return (balance == BALANCE_COST) ? 1 + body.cost : 1;
+}
+
+void splitWork(vector<body>& bodies, balance_t balance, int parts, int* counts, int* displacements) {
+    int bodies_size = bodies.size();
+
+    double total_work = 0;
+    for (int i = 0; i < bodies_size; ++i) {
+        total_work += getBodyWork(bodies[i], balance);
+    }
+
+    // A part starts at the first body whose preceding bodies hold the previous parts' share of the work.
+    double work = 0;
+    int part = 1;
+    displacements[0] = 0;
+    for (int i = 0; i < bodies_size; ++i) {
+        while (part < parts && work >= total_work * part / parts) {
+            displacements[part++] = i;
+        }
+        work += getBodyWork(bodies[i], balance);
+    }
+    while (part < parts) {
+        displacements[part++] = bodies_size;
+    }
+
+    for (int p = 0; p < parts; ++p) {
+        counts[p] = ((p + 1 < parts) ? displacements[p + 1] : bodies_size) - displacements[p];
+    }
+}
+
+void splitChunks(int* counts, int* displacements, int parts, int chunks, int group_size, int* chunk_counts, int* chunk_displacements) {
+    group_size = max(group_size, 1);
+
+    for (int p = 0; p < parts; ++p) {
+        int groups = (counts[p] + group_size - 1) / group_size;
+        for (int c = 0; c < chunks; ++c) {
+            int begin = min(counts[p], group_size * static_cast<int>(static_cast<long>(groups) * c / chunks));
+            int end = min(counts[p], group_size * static_cast<int>(static_cast<long>(groups) * (c + 1) / chunks));
+            chunk_displacements[c * parts + p] = displacements[p] + begin;
+            chunk_counts[c * parts + p] = end - begin;
+        }
+    }
+}
+
+double calculateImbalance(double work, MPI_Comm comm) {
+    int comm_size;
+    double max_work, total_work;
+    MPI_Comm_size(comm, &comm_size);
+    MPI_Allreduce(&work, &max_work, 1, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(&work, &total_work, 1, MPI_DOUBLE, MPI_SUM, comm);
+
+    return (total_work > 0) ? max_work * comm_size / total_work : 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+
+using namespace std;
+
+/*  Returns the rank of the calling process among the processes running on the same node, so processes on a node can
+    split its cores between them.
+*/
+int getNodeLocalRank(MPI_Comm comm);
+
+/*  Pins the calling process and its threads to cores of the node.  Each process on a node gets threads consecutive
+    cores starting at local_rank * threads (wrapping around the cores the process was started with):
+        PIN_NONE    leaves placement to the operating system.
+        PIN_RANK    binds the process to its cores and lets its threads float between them.
+        PIN_THREAD  additionally binds every thread to one of the process's cores.
+    Returns false if the operating system refused the affinity change.
+*/
+bool pinThreads(pin_t pin, int local_rank, int threads);
+
+/*  Returns the work of a body when splitting a step across processes.  With BALANCE_COST it is the number of
+    interactions of the body's last net force plus one for the body itself, so a step without recorded costs falls
+    back to splitting by count.  Lost bodies weigh nothing.
+*/
+double getBodyWork(body& body, balance_t balance);
+
+// Splits bodies into parts ranges of consecutive bodies of about the same work, as counts and displacements for MPI_Allgatherv.
+void splitWork(vector<body>& bodies, balance_t balance, int parts, int* counts, int* displacements);
+
+/*  Splits the range of every one of parts processes, given by counts and displacements, into chunks consecutive
+    chunks.  Chunk c of process p is stored at c * parts + p of chunk_counts and chunk_displacements, so the chunks c of
+    all processes form the counts and displacements of one MPI_Allgatherv.  Chunks start at a multiple of group_size
+    from the start of their process's range, so they split the range into the same groups as a single chunk would.
+*/
+void splitChunks(int* counts, int* displacements, int parts, int chunks, int group_size, int* chunk_counts, int* chunk_displacements);
+
+// Returns the load imbalance of a step, the largest work of a process of comm divided by the mean.  1 is perfectly balanced.
+double calculateImbalance(double work, MPI_Comm comm);
@@ -0,0 +1,103 @@
+#include "particles.h"
+
+int ParticleStore::size() {
+    return index.size();
+}
+
+void ParticleStore::load(vector<body>& bodies) {
+    int bodies_size = bodies.size();
+
+    index.resize(bodies_size);
+    x_pos.resize(bodies_size);
+    y_pos.resize(bodies_size);
+    mass.resize(bodies_size);
+    x_vel.resize(bodies_size);
+    y_vel.resize(bodies_size);
+    F_x.resize(bodies_size);
+    F_y.resize(bodies_size);
+    cost.resize(bodies_size);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < bodies_size; ++i) {
+        index[i] = bodies[i].index;
+        x_pos[i] = bodies[i].x_pos;
+        y_pos[i] = bodies[i].y_pos;
+        mass[i] = bodies[i].mass;
+        x_vel[i] = bodies[i].x_vel;
+        y_vel[i] = bodies[i].y_vel;
+        F_x[i] = bodies[i].F_x;
+        F_y[i] = bodies[i].F_y;
+        cost[i] = bodies[i].cost;
+    }
+}
+
+void ParticleStore::store(vector<body>& bodies, int begin, int end) {
+    #pragma omp parallel for schedule(static)
+    for (int i = begin; i < end; ++i) {
+        bodies[i] = body(index[i], x_pos[i], y_pos[i], mass[i], x_vel[i], y_vel[i], F_x[i], F_y[i], cost[i]);
+    }
+}
+
+void ParticleStore::integrate(int particle_index, IntegrationStep& step) {
+    int i = particle_index;
+    if (mass[i] == -1) {
+        return;
+    }
+
+    double a_x = F_x[i] / mass[i];  // calculate x acceleration
+    double a_y = F_y[i] / mass[i];  // calculate y acceleration
+    double dt = step.dt;
+
+    if (step.integrator == INTEGRATOR_VERLET) {
+        x_pos[i] = x_pos[i] + (x_vel[i] * dt) + (0.5 * a_x * (dt * dt));
+        y_pos[i] = y_pos[i] + (y_vel[i] * dt) + (0.5 * a_y * (dt * dt));
+
+        x_vel[i] = x_vel[i] + (a_x * dt);
+        y_vel[i] = y_vel[i] + (a_y * dt);
+    } else {
+        x_vel[i] = x_vel[i] + (a_x * step.kick_dt);
+        y_vel[i] = y_vel[i] + (a_y * step.kick_dt);
+
+        if (!step.drift) {
+            return;
+        }
+        x_pos[i] = x_pos[i] + (x_vel[i] * dt);
+        y_pos[i] = y_pos[i] + (y_vel[i] * dt);
+    }
+
+    if (x_pos[i] < 0 || x_pos[i] > 4 || y_pos[i] < 0 || y_pos[i] > 4) {
+        mass[i] = -1;
+    }
+}
+
+void ParticleStore::integrate(int begin, int end, IntegrationStep& step) {
+    #pragma omp parallel for schedule(static)
+    for (int i = begin; i < end; ++i) {
+        integrate(i, step);
+    }
+}
+
+IntegrationStep IntegrationStep::get(integrator_t integrator, double dt, int step, int steps) {
+    if (integrator == INTEGRATOR_VERLET) {
+        return {integrator, dt, dt, true};
+    }
+    if (step == steps) {
+        return {integrator, dt, dt / 2, false};
+    }
+    return {integrator, dt, (step == 0) ? dt / 2 : dt, true};
+}
+
+void ParticleStore::roundPositions(int begin, int end) {
+    #pragma omp parallel for schedule(static)
+    for (int i = begin; i < end; ++i) {
+        x_pos[i] = static_cast<float>(x_pos[i]);
+        y_pos[i] = static_cast<float>(y_pos[i]);
+    }
+}
+
+void ParticleStore::storeUpdates(vector<body_update>& updates, int begin, int end) {
+    #pragma omp parallel for schedule(static)
+    for (int i = begin; i < end; ++i) {
+        updates[i] = {static_cast<float>(x_pos[i]), static_cast<float>(y_pos[i]), cost[i], x_vel[i], y_vel[i], mass[i]};
+    }
+}
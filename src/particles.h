@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+
+using namespace std;
+
+/*  One step of an integrator, applied to a particle once its net force is known.
+        INTEGRATOR_VERLET   x += v*dt + a*dt^2/2 and v += a*dt, the same way body::calculateLeapFrogVertletIntegration() does.
+        INTEGRATOR_KDK      v += a*kick_dt, then x += v*dt if drift is set.  The velocities are kept half a step behind the
+                            positions: the first step kicks for dt/2, every following step closes the last step's kick and
+                            opens its own with a single kick for dt, and a final step without drift kicks for the last dt/2.
+                            Every force is used by both kicks it belongs to, so it is calculated once.
+*/
+struct IntegrationStep {
+    integrator_t integrator;
+    double dt;
+    double kick_dt;
+    bool drift;
+
+    // Returns the integration step of step out of steps.  Kick-drift-kick runs an extra closing step at steps.
+    static IntegrationStep get(integrator_t integrator, double dt, int step, int steps);
+};
+
+/*  Structure of arrays (SoA) copy of the bodies used by the force and integration loops.  Every field of a body
+    lives in its own contiguous array, so the loops stream through just the fields they need and can be vectorized.
+    The array of structures (AoS) body stays the format for file I/O and MPI communication: load() and store() copy
+    between the two.
+*/
+struct ParticleStore {
+    vector<int> index;
+    vector<double> x_pos, y_pos;
+    vector<double> mass;
+    vector<double> x_vel, y_vel;
+    vector<double> F_x, F_y;
+    vector<int> cost;
+
+    // Returns the number of particles in the store.
+    int size();
+
+    // Copies all bodies into the store, resizing it to the number of bodies.
+    void load(vector<body>& bodies);
+
+    // Copies the particles in [begin, end) back into the bodies at the same positions.
+    void store(vector<body>& bodies, int begin, int end);
+
+    // Moves the particle at particle_index by one integration step from its net force.
+    void integrate(int particle_index, IntegrationStep& step);
+
+    // Moves the particles in [begin, end) by one integration step from their net force.
+    void integrate(int begin, int end, IntegrationStep& step);
+
+    // Rounds the positions of the particles in [begin, end) to float, so they are the same as the ones other processes receive as body_updates.
+    void roundPositions(int begin, int end);
+
+    // Copies the changing state of the particles in [begin, end) into the updates at the same positions.
+    void storeUpdates(vector<body_update>& updates, int begin, int end);
+};
@@ -0,0 +1,108 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Names of the columns of a row, as they appear in the output.
+const char* PROFILER_COLUMNS[] = {"wall", "io", "decomposition", "tree_build", "flatten", "prepare", "force", "store", "communication", "node_visits", "interactions", "bytes_sent", "bytes_received"};
+
+Profiler::Profiler() {
+    first_step = 0;
+    row = 0;
+    rows.assign(ROW_SIZE, 0);
+    run_start = MPI_Wtime();
+    step_start = run_start;
+    fill(phase_starts, phase_starts + PHASE_COUNT, 0);
+}
+
+void Profiler::beginStep(int step) {
+    if (rows.size() == ROW_SIZE) {
+        first_step = step;
+    }
+    row = 1 + step - first_step;
+    if (rows.size() < static_cast<size_t>((row + 1) * ROW_SIZE)) {
+        rows.resize((row + 1) * ROW_SIZE, 0);
+    }
+    step_start = MPI_Wtime();
+}
+
+void Profiler::endStep() {
+    rows[row * ROW_SIZE] += MPI_Wtime() - step_start;
+    row = 0;
+}
+
+void Profiler::start(phase_t phase) {
+    phase_starts[phase] = MPI_Wtime();
+}
+
+void Profiler::stop(phase_t phase) {
+    rows[row * ROW_SIZE + 1 + phase] += MPI_Wtime() - phase_starts[phase];
+}
+
+void Profiler::add(counter_t counter, double value) {
+    rows[row * ROW_SIZE + 1 + PHASE_COUNT + counter] += value;
+}
+
+void Profiler::write(const char* filename, MPI_Comm comm, int root) {
+    int comm_size, comm_rank;
+    MPI_Comm_size(comm, &comm_size);
+    MPI_Comm_rank(comm, &comm_rank);
+
+    rows[0] = MPI_Wtime() - run_start;
+
+    // Every process ran the same steps, so all of them have as many rows.
+    int rows_size = rows.size();
+    vector<double> all_rows((comm_rank == root) ? rows_size * comm_size : 0);
+    MPI_Gather(rows.data(), rows_size, MPI_DOUBLE, all_rows.data(), rows_size, MPI_DOUBLE, root, comm);
+    if (comm_rank != root) {
+        return;
+    }
+
+    FILE* out = fopen(filename, "w");
+    if (out == NULL) {
+        std::cerr << "profiler: cannot open " << filename << "." << std::endl;
+        return;
+    }
+
+    size_t length = strlen(filename);
+    bool csv = length >= 4 && strcmp(filename + length - 4, ".csv") == 0;
+    if (csv) {
+        fprintf(out, "rank,step");
+        for (const char* column : PROFILER_COLUMNS) {
+            fprintf(out, ",%s", column);
+        }
+        fprintf(out, "\n");
+    } else {
+        fprintf(out, "{\"columns\": [\"rank\", \"step\"");
+        for (const char* column : PROFILER_COLUMNS) {
+            fprintf(out, ", \"%s\"", column);
+        }
+        fprintf(out, "],\n \"rows\": [");
+    }
+
+    // Times are written in seconds, counters as whole numbers.
+    const char* separator = csv ? "," : ", ";
+    int steps = rows_size / ROW_SIZE;
+    for (int p = 0; p < comm_size; ++p) {
+        for (int r = 0; r < steps; ++r) {
+            double* values = &all_rows[p * rows_size + r * ROW_SIZE];
+            int step = (r == 0) ? -1 : first_step + r - 1;
+            if (csv) {
+                fprintf(out, "%d,%d", p, step);
+            } else {
+                fprintf(out, "%s\n  [%d, %d", (p == 0 && r == 0) ? "" : ",", p, step);
+            }
+            for (int column = 0; column < ROW_SIZE; ++column) {
+                fprintf(out, (column <= PHASE_COUNT) ? "%s%.9f" : "%s%.0f", separator, values[column]);
+            }
+            fprintf(out, csv ? "\n" : "]");
+        }
+    }
+
+    if (!csv) {
+        fprintf(out, "\n ]}\n");
+    }
+    fclose(out);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <mpi.h>
+
+#include <vector>
+
+using namespace std;
+
+// Phases of a run the profiler times.
+enum phase_t {
+    PHASE_IO,             // Reading and writing body, checkpoint and trajectory files, including the gathers for them.
+    PHASE_DECOMPOSITION,  // Repartitioning the bodies of a distributed run and exchanging the locally essential trees.
+    PHASE_TREE_BUILD,     // Building the Barnes-Hut Tree and the centers of mass of its nodes.
+    PHASE_FLATTEN,        // Laying the tree out for the force calculation and loading the particle store.
+    PHASE_PREPARE,        // Getting the force solver ready for the step, e.g. the expansions of the fast multipole method.
+    PHASE_FORCE,          // Calculating the net forces, with the integration fused into the same pass.
+    PHASE_STORE,          // Copying the integrated particles back into the bodies.
+    PHASE_COMMUNICATION,  // Exchanging the bodies of a replicated run, including the wait for them.
+    PHASE_COUNT
+};
+
+// Quantities the profiler counts.
+enum counter_t {
+    COUNTER_NODE_VISITS,     // Tree nodes visited while calculating net forces.
+    COUNTER_INTERACTIONS,    // Bodies and pseudo-particles the net forces were summed over, less the one of every particle's own body.
+    COUNTER_BYTES_SENT,      // Bytes of bodies and sources sent to other processes.
+    COUNTER_BYTES_RECEIVED,  // Bytes of bodies and sources received from other processes.
+    COUNTER_COUNT
+};
+
+/*  Collects the time every process spends in every phase and its counters, step by step.  Everything outside the
+    steps is collected as step -1, whose wall time is the whole run.  Timing a phase costs two MPI_Wtime() calls, so
+    the profiler is always on and only writing the results is optional.
+*/
+class Profiler {
+   public:
+    /* Public Functions */
+    Profiler();
+
+    // Collects into the row of step until endStep().
+    void beginStep(int step);
+
+    // Collects into the row of step -1 again.
+    void endStep();
+
+    // Starts timing phase.
+    void start(phase_t phase);
+
+    // Stops timing phase and adds the time since start() to it.
+    void stop(phase_t phase);
+
+    // Adds value to counter.
+    void add(counter_t counter, double value);
+
+    /*  Gathers the rows of every process of comm to the root, which writes them to filename as CSV if its name ends in
+        .csv and as JSON otherwise.  Both have one row per process and step with the columns rank, step, wall time,
+        the phase times in seconds and the counters.
+    */
+    void write(const char* filename, MPI_Comm comm, int root);
+
+   private:
+    // Wall time, phase times and counters of a row.
+    static const int ROW_SIZE = 1 + PHASE_COUNT + COUNTER_COUNT;
+
+    int first_step;
+    int row;
+    vector<double> rows;  // ROW_SIZE values per row, step -1 first and then the steps from first_step on.
+    double step_start;
+    double run_start;
+    double phase_starts[PHASE_COUNT];
+};
@@ -0,0 +1,65 @@
+#include "solver.h"
+
+#include <omp.h>
+
+// Custom Libraries
+#include "fmm.h"
+#include "helpers.h"
+
+BarnesHutSolver::BarnesHutSolver(BHTree& input_tree, double input_theta, int input_group_size) : tree(input_tree) {
+    theta = input_theta;
+    group_size = input_group_size;
+}
+
+long BarnesHutSolver::prepare(ParticleStore&) {
+    return 0;
+}
+
+long BarnesHutSolver::calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) {
+    return tree.calculateNetForces(particles, begin, end, theta, group_size, step);
+}
+
+long DirectSolver::prepare(ParticleStore& particles) {
+    sources.clear();
+    int particles_size = particles.size();
+    for (int i = 0; i < particles_size; ++i) {
+        if (particles.mass[i] != -1) {
+            sources.add(particles.x_pos[i], particles.y_pos[i], particles.mass[i]);
+        }
+    }
+    return 0;
+}
+
+long DirectSolver::calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = begin; i < end; ++i) {
+        particles.F_x[i] = 0;
+        particles.F_y[i] = 0;
+        particles.cost[i] = 0;
+
+        // Lost bodies do not move anymore, so they do not need a net force.
+        if (particles.mass[i] != -1) {
+            double F_x = 0;
+            double F_y = 0;
+            accumulateForce(particles.x_pos[i], particles.y_pos[i], sources, &F_x, &F_y);
+
+            particles.cost[i] = sources.size();
+            particles.F_x[i] = G * particles.mass[i] * F_x;
+            particles.F_y[i] = G * particles.mass[i] * F_y;
+        }
+
+        if (step != nullptr) {
+            particles.integrate(i, *step);
+        }
+    }
+    return 0;
+}
+
+unique_ptr<ForceSolver> createForceSolver(struct options_t& opts, BHTree& tree) {
+    if (opts.solver == SOLVER_FMM) {
+        return make_unique<FmmSolver>(tree, opts.theta, opts.tolerance);
+    } else if (opts.solver == SOLVER_DIRECT) {
+        return make_unique<DirectSolver>();
+    }
+    return make_unique<BarnesHutSolver>(tree, opts.theta, opts.group_size);
+}
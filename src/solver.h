@@ -0,0 +1,64 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "bhtree.h"
+#include "kernels.h"
+#include "particles.h"
+
+using namespace std;
+
+/*  Calculates the net forces of a step.  The Barnes-Hut Tree is built and flattened every step whatever the solver,
+    then prepare() is called once and calculateNetForces() for every range of particles the process works on, so a
+    replicated run still splits the bodies between its processes and chunks.  A particle may be integrated right after
+    its net force, so a solver only reads the positions of other bodies from the tree, or from its own copy.
+*/
+class ForceSolver {
+   public:
+    virtual ~ForceSolver() {}
+
+    // Gets ready for the step's net forces once the tree is flattened and the particles are loaded.  Returns the number of nodes visited.
+    virtual long prepare(ParticleStore& particles) = 0;
+
+    /*  Calculates the net force onto the particles in [begin, end), spread across the process's threads, and records
+        the number of bodies and nodes each one was summed over as its cost.  If step is given, every particle is
+        integrated right after its net force.  Returns the number of nodes visited.
+    */
+    virtual long calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) = 0;
+};
+
+// Barnes-Hut solver, see BHTree::calculateNetForces().
+class BarnesHutSolver : public ForceSolver {
+   public:
+    BarnesHutSolver(BHTree& input_tree, double input_theta, int input_group_size);
+
+    long prepare(ParticleStore& particles) override;
+
+    long calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) override;
+
+   private:
+    BHTree& tree;
+    double theta;
+    int group_size;
+};
+
+/*  Sums up the force of every body onto every other body.  The positions and masses of the bodies still in the
+    simulation are copied into a single interaction list by prepare(), which every particle is then evaluated against
+    with the selected force kernel.  Quadratic in the number of bodies, it is the reference the other solvers are
+    measured against.
+*/
+class DirectSolver : public ForceSolver {
+   public:
+    long prepare(ParticleStore& particles) override;
+
+    long calculateNetForces(ParticleStore& particles, int begin, int end, IntegrationStep* step) override;
+
+   private:
+    InteractionList sources;
+};
+
+// Creates the solver selected by opts for the tree main() builds every step.
+unique_ptr<ForceSolver> createForceSolver(struct options_t& opts, BHTree& tree);
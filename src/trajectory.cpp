@@ -0,0 +1,128 @@
+#include "trajectory.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+TrajectoryWriter::TrajectoryWriter(const char* filename, int input_count, int start_step) {
+    count = input_count;
+    written = 0;
+    queued = 0;
+    closing = false;
+    for (int slot = 0; slot < TRAJECTORY_SLOTS; ++slot) {
+        positions[slot].resize(2 * count);
+    }
+
+    out = openFile(filename, start_step);
+    if (out == NULL) {
+        std::cerr << "trajectory: cannot open " << filename << "." << std::endl;
+        exit(1);
+    }
+    writer = thread(&TrajectoryWriter::writeFrames, this);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+void TrajectoryWriter::push(vector<body>& bodies, int step, double dt) {
+    unique_lock<mutex> lock(ring_mutex);
+    frame_written.wait(lock, [this] { return queued - written < TRAJECTORY_SLOTS; });
+    int slot = queued % TRAJECTORY_SLOTS;
+    lock.unlock();
+
+    // The writer thread never touches a free slot, so it is filled without the lock.
+    double* x_pos = positions[slot].data();
+    double* y_pos = x_pos + count;
+    fill(positions[slot].begin(), positions[slot].end(), NAN);
+    for (body& body : bodies) {
+        if (body.mass != -1 && body.index >= 0 && body.index < count) {
+            x_pos[body.index] = body.x_pos;
+            y_pos[body.index] = body.y_pos;
+        }
+    }
+    frame_headers[slot] = {step, step * dt};
+
+    lock.lock();
+    ++queued;
+    frame_queued.notify_one();
+}
+
+void TrajectoryWriter::flush() {
+    unique_lock<mutex> lock(ring_mutex);
+    frame_written.wait(lock, [this] { return written == queued; });
+}
+
+void TrajectoryWriter::close() {
+    if (!writer.joinable()) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(ring_mutex);
+        closing = true;
+    }
+    frame_queued.notify_one();
+    writer.join();
+    fclose(out);
+}
+
+FILE* TrajectoryWriter::openFile(const char* filename, int start_step) {
+    trajectory_header header;
+    memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(header.magic));
+    header.version = TRAJECTORY_VERSION;
+    header.header_size = sizeof(trajectory_header);
+    header.count = count;
+    header.frame_size = sizeof(trajectory_frame_header) + 2 * sizeof(double) * count;
+
+    FILE* file = (start_step > 0) ? fopen(filename, "r+b") : NULL;
+    if (file != NULL) {
+        // Keep the earlier run's whole frames up to the restart, which also drops a frame it was killed writing.
+        trajectory_header file_header;
+        struct stat file_stat;
+        bool matches = fread(&file_header, sizeof(file_header), 1, file) == 1 && memcmp(&file_header, &header, sizeof(header)) == 0 && fstat(fileno(file), &file_stat) == 0;
+        long frames = 0;
+        trajectory_frame_header frame_header;
+        while (matches && header.header_size + (frames + 1) * header.frame_size <= static_cast<uint64_t>(file_stat.st_size) && fseek(file, header.header_size + frames * header.frame_size, SEEK_SET) == 0 && fread(&frame_header, sizeof(frame_header), 1, file) == 1 && frame_header.step <= start_step) {
+            ++frames;
+        }
+
+        long size = header.header_size + frames * header.frame_size;
+        if (matches && fflush(file) == 0 && ftruncate(fileno(file), size) == 0 && fseek(file, size, SEEK_SET) == 0) {
+            return file;
+        }
+        fclose(file);
+    }
+
+    file = fopen(filename, "wb");
+    if (file != NULL && (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0)) {
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+void TrajectoryWriter::writeFrames() {
+    unique_lock<mutex> lock(ring_mutex);
+    while (true) {
+        frame_queued.wait(lock, [this] { return queued > written || closing; });
+        if (queued == written) {
+            return;
+        }
+        int slot = written % TRAJECTORY_SLOTS;
+        lock.unlock();
+
+        // Flushed frame by frame, so readers see every frame as soon as it is complete.
+        bool saved = fwrite(&frame_headers[slot], sizeof(trajectory_frame_header), 1, out) == 1 && fwrite(positions[slot].data(), sizeof(double), 2 * count, out) == static_cast<size_t>(2 * count) && fflush(out) == 0;
+        if (!saved) {
+            std::cerr << "trajectory: cannot write the frame of step " << frame_headers[slot].step << "." << std::endl;
+        }
+
+        lock.lock();
+        ++written;
+        frame_written.notify_one();
+    }
+}
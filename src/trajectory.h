@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Custom Libraries
+#include "body.h"
+
+using namespace std;
+
+// Bytes a trajectory file starts with.
+const char TRAJECTORY_MAGIC[8] = {'N', 'B', 'O', 'D', 'Y', 'T', 'R', 'J'};
+
+// Version of the trajectory file format.
+const uint32_t TRAJECTORY_VERSION = 1;
+
+// Number of snapshots that can wait for the writer thread before a step has to wait for it.
+const int TRAJECTORY_SLOTS = 4;
+
+/*  Header of a trajectory file.  It is followed by frames of frame_size bytes each: a trajectory_frame_header and
+    then the x positions and the y positions of all count bodies (float64), in body index order.  Lost bodies have
+    NaN positions.  Frames are only ever appended, so a reader can open the file while the run is still going and
+    take its first (file size - header_size) / frame_size frames, ignoring a frame that is still being written.
+*/
+struct trajectory_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;  // Bytes from the start of the file to the first frame.
+    uint64_t count;
+    uint64_t frame_size;
+};
+
+struct trajectory_frame_header {
+    int64_t step;  // Steps run before the snapshot was taken.
+    double time;
+};
+
+/*  Streams snapshots of the bodies' positions to a trajectory file.  push() copies the positions into a bounded
+    ring of TRAJECTORY_SLOTS frames and returns, a background thread appends the queued frames to the file.  The
+    step loop only waits if the writer falls a whole ring behind.
+*/
+class TrajectoryWriter {
+   public:
+    /* Public Functions */
+    /*  Opens the trajectory file of count bodies.  A run starting at step 0 creates a new file, a run restarted at
+        a later step continues the file an earlier run wrote, dropping the frames taken after that step.
+    */
+    TrajectoryWriter(const char* filename, int input_count, int start_step);
+
+    // Writes the queued frames and closes the file.
+    ~TrajectoryWriter();
+
+    // Queues a snapshot of the bodies' positions after step steps of dt.  Waits while the ring is full.
+    void push(vector<body>& bodies, int step, double dt);
+
+    // Waits until every queued frame is in the file, so a checkpoint taken next never skips snapshots on restart.
+    void flush();
+
+    // Writes the queued frames and closes the file.  Nothing can be pushed afterwards.
+    void close();
+
+   private:
+    FILE* out;
+    int count;
+
+    // Ring of frames.  Frames [written, queued) wait for the writer thread, the others are free for push().
+    vector<double> positions[TRAJECTORY_SLOTS];
+    trajectory_frame_header frame_headers[TRAJECTORY_SLOTS];
+    long written, queued;
+    bool closing;
+    mutex ring_mutex;
+    condition_variable frame_queued, frame_written;
+    thread writer;
+
+    /* Private Functions */
+    // Opens the file for appending after the frames of steps up to start_step, or creates it.  Returns the file, or NULL.
+    FILE* openFile(const char* filename, int start_step);
+
+    // Appends queued frames to the file until close() is called and the ring is empty.
+    void writeFrames();
+};
@@ -1,7 +1,6 @@
 #pragma once
 
 #include <vector>
-#include <memory>
 
 // Custom Libraries
 #include "argparse.h"
@@ -9,57 +8,34 @@
 
 using namespace std;
 
-class TreeNode {
-   public:
-    /* Public Functions */
+/*  A node of the Barnes-Hut Tree.  Nodes are stored in the contiguous node pool of a BHTree and reference
+    their children and their body by index instead of by pointer, so a whole tree can be thrown away and rebuilt
+    without any heap allocation.
+*/
+struct TreeNode {
+    int level;
+    double x, y, space_length;
+    int first_child;  // Node pool index of the NW child.  The NE, SW and SE children directly follow it.  -1 if the node is a leaf.
+    int body_index;  // Index of the leaf's first body in the tree's bodies array, the rest are linked through the tree's next_body list.  -1 if the node has no body.
+    int last_body;  // Index of the leaf's last body, which new bodies are linked after.  -1 if the node has no body.
+    int body_count;  // Number of bodies in the leaf.
+    double com_x_sum, com_y_sum;  // Pre-Center of Mass (com) summation before dividing by total mass
+    double com_x, com_y;  // Center of Mass (com)
+    double total_mass;
+    double radius;  // Distance from the center of mass to the farthest body below the node, or an upper bound of it.  Only measured for OPENING_BMAX.
+
     // Creates a TreeNode for a Barnes-Hut Tree.
-    TreeNode(int input_level, double input_space_length, double = 0, double = 0);
-    ~TreeNode();
+    TreeNode(int input_level = 0, double input_space_length = 0, double input_x = 0, double input_y = 0) : level(input_level), x(input_x), y(input_y), space_length(input_space_length), first_child(-1), body_index(-1), last_body(-1), body_count(0), com_x_sum(0), com_y_sum(0), com_x(0), com_y(0), total_mass(0), radius(0) {}
 
     // Returns the TreeNode's x position.
     double getXPosition();
-    
+
     // Returns the TreeNode's y position.
     double getYPosition();
 
     // Returns the TreeNode's space length.
     double getSpaceLength();
 
-    // Returns a pointer reference to the TreeNode's children vector.
-    vector<shared_ptr<TreeNode>>* getChildren();
-
     // True if the node is a leaf or False if it isn't.
     bool isLeaf();
-
-    // Inserts a body into a TreeNode.
-    void insertBody(body& body);
-
-    // Caculates the center of mass for the TreeNodes in a Barnes-Hut Tree.
-    void calculateCenterOfMass();
-
-    /*  Calculate the net force onto a body using the following calculations:
-        Fx = G*M0*M1*dx / d^3
-        Fy = G*M0*M1*dy / d^3
-    */
-    void calculateNetForce(body& body, double theta);
-
-    // Recursively traverses the tree from the root to print out the internal space nodes and external space nodes.
-    void printTree();
-
-   private:
-    int level;
-    double x, y, space_length;
-    vector<shared_ptr<TreeNode>> children;
-    bool leaf;
-    body* node_body_ptr;
-    double com_x_sum, com_y_sum;  // Pre-Center of Mass (com) summation before dividing by total mass
-    double com_x, com_y;  // Center of Mass (com)
-    double total_mass;
-
-    /* Private Functions */
-    // Creates children TreeNodes for NW, NE, SW, SE spaces.
-    void subdivide();
-
-    // Determines which children the body needs to be dispatced to, to insert the body into the appropriate TreeNode.
-    void dispatchInsertBody(body& body);
-};
\ No newline at end of file
+};
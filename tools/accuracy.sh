@@ -0,0 +1,70 @@
+#!/bin/sh
+# Measures the force error against direct summation and the time it took, over theta and the multipole order.  Every
+# input first takes one step with theta 0, which opens every node and sums up every body directly, and every other run
+# takes the same step and is compared against it (see tools/compare.cpp).  Results go into one CSV file, one row per
+# run, with the time and interactions of the step's tree build, flattening, solver preparation and force calculation summed over processes.
+# Every sweep is a space separated list that can be overridden from the environment:
+#     THETAS="0.3 0.5 0.7 0.9" ORDERS="0 2" BODIES="20000" ./tools/accuracy.sh
+# Direct summation is quadratic in the number of bodies, so the default sizes stay small.
+
+DISTRIBUTIONS=${DISTRIBUTIONS:-"uniform plummer clustered disk"}
+BODIES=${BODIES:-"1000 10000"}
+THETAS=${THETAS:-"0.3 0.5 0.7 0.9"}
+ORDERS=${ORDERS:-"0 2"}
+LEAF_SIZE=${LEAF_SIZE:-1}
+RANKS=${RANKS:-1}
+DT=${DT:-0.005}
+SEED=${SEED:-1}
+EXTRA_OPTS=${EXTRA_OPTS:-""}
+MPIRUN=${MPIRUN:-"mpirun --bind-to none"}
+NBODY=${NBODY:-./bin/nbody}
+GENERATE=${GENERATE:-./bin/nbody-generate}
+COMPARE=${COMPARE:-./bin/nbody-compare}
+INPUT_DIR=${INPUT_DIR:-input/bench}
+RESULTS=${RESULTS:-accuracy-results.csv}
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+mkdir -p "$INPUT_DIR"
+
+# Sums the named columns of the step 0 rows of a profile, comma separated.
+sum_columns() {
+    awk -F, -v names="$2" '
+        NR == 1 { for (i = 1; i <= NF; ++i) column[$i] = i; next }
+        $2 == 0 { split(names, n, " "); for (j in n) sum[j] += $column[n[j]] }
+        END { split(names, n, " "); for (j = 1; j <= length(n); ++j) printf "%s%.9g", (j > 1) ? "," : "", sum[j] }
+    ' "$1"
+}
+
+echo "distribution,bodies,theta,multipole_order,leaf_size,ranks,tree_build,flatten,prepare,force,interactions,median_error,rms_error,max_error" > "$RESULTS"
+for distribution in $DISTRIBUTIONS; do
+    for bodies in $BODIES; do
+        input="$INPUT_DIR/$distribution-$bodies-$SEED.bin"
+        if [ ! -f "$input" ]; then
+            "$GENERATE" "$distribution" "$bodies" "$input" "$SEED" || exit 1
+        fi
+
+        echo "accuracy: $distribution n=$bodies direct summation" >&2
+        reference="$WORK_DIR/reference.bin"
+        if ! $MPIRUN -np "$RANKS" "$NBODY" -i "$input" -o "$reference" -s 1 -t 0 -d "$DT" -l "$LEAF_SIZE" $EXTRA_OPTS > /dev/null; then
+            echo "accuracy: reference run failed, skipping the input" >&2
+            continue
+        fi
+
+        for theta in $THETAS; do
+            for order in $ORDERS; do
+                echo "accuracy: $distribution n=$bodies theta=$theta order=$order" >&2
+                profile="$WORK_DIR/profile.csv"
+                if ! $MPIRUN -np "$RANKS" "$NBODY" -i "$input" -o "$WORK_DIR/output.bin" -s 1 -t "$theta" -d "$DT" -l "$LEAF_SIZE" -M "$order" -P "$profile" $EXTRA_OPTS > /dev/null; then
+                    echo "accuracy: run failed, skipping it" >&2
+                    continue
+                fi
+
+                errors=$("$COMPARE" "$input" "$reference" "$WORK_DIR/output.bin") || continue
+                echo "$distribution,$bodies,$theta,$order,$LEAF_SIZE,$RANKS,$(sum_columns "$profile" "tree_build flatten prepare force interactions"),$errors" >> "$RESULTS"
+            done
+        done
+    done
+done
+
+echo "accuracy: results written to $RESULTS" >&2
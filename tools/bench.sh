@@ -0,0 +1,59 @@
+#!/bin/sh
+# Sweeps the simulation over distributions, body counts, theta, leaf sizes, threads and processes, and collects the
+# per-step phase times and counters of every run (see --profile) into one CSV file with the run's parameters in front.
+# Every sweep is a space separated list that can be overridden from the environment:
+#     DISTRIBUTIONS="plummer disk" BODIES="10000 100000" RANKS="1 4" ./tools/bench.sh
+# Inputs are generated once into $INPUT_DIR and reused by later sweeps.
+
+DISTRIBUTIONS=${DISTRIBUTIONS:-"uniform plummer clustered disk"}
+BODIES=${BODIES:-"1000 10000 100000"}
+THETAS=${THETAS:-"0.5"}
+LEAF_SIZES=${LEAF_SIZES:-"1 8"}
+THREADS=${THREADS:-"1"}
+RANKS=${RANKS:-"1 2 4"}
+STEPS=${STEPS:-10}
+DT=${DT:-0.005}
+SEED=${SEED:-1}
+EXTRA_OPTS=${EXTRA_OPTS:-""}
+MPIRUN=${MPIRUN:-"mpirun --bind-to none"}
+NBODY=${NBODY:-./bin/nbody}
+GENERATE=${GENERATE:-./bin/nbody-generate}
+INPUT_DIR=${INPUT_DIR:-input/bench}
+RESULTS=${RESULTS:-bench-results.csv}
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "$WORK_DIR"' EXIT
+mkdir -p "$INPUT_DIR"
+
+header_written=false
+for distribution in $DISTRIBUTIONS; do
+    for bodies in $BODIES; do
+        input="$INPUT_DIR/$distribution-$bodies-$SEED.bin"
+        if [ ! -f "$input" ]; then
+            "$GENERATE" "$distribution" "$bodies" "$input" "$SEED" || exit 1
+        fi
+
+        for theta in $THETAS; do
+            for leaf_size in $LEAF_SIZES; do
+                for threads in $THREADS; do
+                    for ranks in $RANKS; do
+                        echo "bench: $distribution n=$bodies theta=$theta leaf=$leaf_size threads=$threads ranks=$ranks" >&2
+                        profile="$WORK_DIR/profile.csv"
+                        if ! $MPIRUN -np "$ranks" "$NBODY" -i "$input" -o "$WORK_DIR/output.bin" -s "$STEPS" -t "$theta" -d "$DT" -l "$leaf_size" -n "$threads" -P "$profile" $EXTRA_OPTS > /dev/null; then
+                            echo "bench: run failed, skipping it" >&2
+                            continue
+                        fi
+
+                        if [ "$header_written" = false ]; then
+                            echo "distribution,bodies,theta,leaf_size,threads,ranks,$(head -n 1 "$profile")" > "$RESULTS"
+                            header_written=true
+                        fi
+                        tail -n +2 "$profile" | sed "s/^/$distribution,$bodies,$theta,$leaf_size,$threads,$ranks,/" >> "$RESULTS"
+                    done
+                done
+            done
+        done
+    done
+done
+
+echo "bench: results written to $RESULTS" >&2
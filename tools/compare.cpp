@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+#include "io.h"
+
+// namespaces
+using namespace std;
+
+// Reads the bodies of a body file of any format, sorted by their indices.
+static vector<body> readBodies(char* filename) {
+    struct options_t opts;
+    opts.input_filename = filename;
+    vector<body> bodies;
+    read_file(&opts, bodies);
+    sort(bodies.begin(), bodies.end(), [](const body& a, const body& b) { return a.index < b.index; });
+    return bodies;
+}
+
+/*  Measures the force error of a run against a reference run, such as one with theta 0, which sums up every body
+    directly.  Both runs must have taken one step from the same input with the verlet integrator, so the change of
+    every body's velocity is its net force over its mass times dt.  Prints the median, the root mean square and the
+    maximum of the bodies' relative force errors as median_error,rms_error,max_error:
+        ./bin/nbody-compare input/plummer-10000.bin output/direct.bin output/theta-0.5.bin
+    Bodies lost in either run are left out.  Text outputs round the velocities, binary ones keep them exact.  Close
+    encounters inside rlimit dominate the tail of the errors, the median shows the far field.
+*/
+int main(int argc, char** argv) {
+    if (argc != 4) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "\t" << argv[0] << " <input file name> <reference output file name> <output file name>" << std::endl;
+        exit(0);
+    }
+
+    vector<body> input = readBodies(argv[1]);
+    vector<body> reference = readBodies(argv[2]);
+    vector<body> output = readBodies(argv[3]);
+    if (reference.size() != input.size() || output.size() != input.size()) {
+        std::cerr << argv[0] << ": the files must have as many bodies." << std::endl;
+        exit(1);
+    }
+
+    vector<double> errors;
+    int count = input.size();
+    for (int i = 0; i < count; ++i) {
+        body& initial = input[i];
+        body& expected = reference[i];
+        body& actual = output[i];
+        if (expected.index != initial.index || actual.index != initial.index) {
+            std::cerr << argv[0] << ": the files do not hold the same bodies." << std::endl;
+            exit(1);
+        }
+        if (expected.mass == -1 || actual.mass == -1) {
+            continue;
+        }
+
+        double expected_x = expected.x_vel - initial.x_vel;
+        double expected_y = expected.y_vel - initial.y_vel;
+        double expected_norm = sqrt((expected_x * expected_x) + (expected_y * expected_y));
+        if (expected_norm == 0) {
+            continue;
+        }
+
+        errors.push_back(hypot(actual.x_vel - expected.x_vel, actual.y_vel - expected.y_vel) / expected_norm);
+    }
+
+    if (errors.empty()) {
+        std::cerr << argv[0] << ": no body felt any force." << std::endl;
+        exit(1);
+    }
+    sort(errors.begin(), errors.end());
+    double sum_sq = 0;
+    for (double error : errors) {
+        sum_sq += error * error;
+    }
+    printf("%.6e,%.6e,%.6e\n", errors[errors.size() / 2], sqrt(sum_sq / errors.size()), errors.back());
+}
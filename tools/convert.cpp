@@ -0,0 +1,30 @@
+#include <iostream>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+#include "io.h"
+
+// namespaces
+using namespace std;
+
+/*  Converts a body file between the text and the binary format.  The input format is detected from the file, the
+    output is written as a binary body file if its name ends in .bin and as text otherwise:
+        ./bin/nbody-convert input/nb-100000.txt input/nb-100000.bin
+*/
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "\t" << argv[0] << " <input file name> <output file name, .bin for the binary format>" << std::endl;
+        exit(0);
+    }
+
+    struct options_t opts;
+    opts.input_filename = argv[1];
+    opts.output_filename = argv[2];
+
+    vector<body> bodies;
+    read_file(&opts, bodies);
+    write_file(&opts, bodies);
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "body.h"
+#include "helpers.h"
+#include "io.h"
+
+// namespaces
+using namespace std;
+
+// Side length of the simulated space.  Bodies outside of it are lost, so every distribution is clipped to it.
+const double SPACE_LENGTH = 4;
+
+// Number of clusters of the clustered distribution.
+const int CLUSTERS = 16;
+
+// Returns a position clipped to the simulated space.
+static double clip(double position) {
+    return min(max(position, 0.0), SPACE_LENGTH);
+}
+
+// Bodies spread evenly over the whole space with small random velocities.
+static void generateUniform(vector<body>& bodies, mt19937_64& random) {
+    uniform_real_distribution<double> position(0, SPACE_LENGTH), velocity(-0.1, 0.1);
+    for (body& body : bodies) {
+        body.x_pos = position(random);
+        body.y_pos = position(random);
+        body.x_vel = velocity(random);
+        body.y_vel = velocity(random);
+    }
+}
+
+// A Plummer sphere of scale radius 0.25 in the center of the space, projected onto the plane, at rest.
+static void generatePlummer(vector<body>& bodies, mt19937_64& random) {
+    uniform_real_distribution<double> unit(0, 1);
+    double scale = 0.25;
+    for (body& body : bodies) {
+        // Invert the Plummer mass profile for the radius, cut off well inside the space, and pick a direction in 3D.
+        double radius;
+        do {
+            radius = scale / sqrt(pow(unit(random), -2.0 / 3.0) - 1);
+        } while (radius > 0.45 * SPACE_LENGTH);
+        double cos_polar = 2 * unit(random) - 1;
+        double azimuth = 2 * M_PI * unit(random);
+        double projected = radius * sqrt(1 - cos_polar * cos_polar);
+
+        body.x_pos = clip(SPACE_LENGTH / 2 + projected * cos(azimuth));
+        body.y_pos = clip(SPACE_LENGTH / 2 + projected * sin(azimuth));
+        body.x_vel = 0;
+        body.y_vel = 0;
+    }
+}
+
+// CLUSTERS tight Gaussian clusters at random places, each moving as a whole, which stresses the load balancing.
+static void generateClustered(vector<body>& bodies, mt19937_64& random) {
+    uniform_real_distribution<double> center(0.5, SPACE_LENGTH - 0.5), velocity(-0.1, 0.1);
+    normal_distribution<double> offset(0, 0.05);
+    double centers[CLUSTERS][4];
+    for (int c = 0; c < CLUSTERS; ++c) {
+        centers[c][0] = center(random);
+        centers[c][1] = center(random);
+        centers[c][2] = velocity(random);
+        centers[c][3] = velocity(random);
+    }
+
+    uniform_int_distribution<int> cluster(0, CLUSTERS - 1);
+    for (body& body : bodies) {
+        double* c = centers[cluster(random)];
+        body.x_pos = clip(c[0] + offset(random));
+        body.y_pos = clip(c[1] + offset(random));
+        body.x_vel = c[2];
+        body.y_vel = c[3];
+    }
+}
+
+// An exponential disk of scale length 0.4 in the center of the space, rotating with the velocity of a circular orbit around the mass inside each body's radius.
+static void generateDisk(vector<body>& bodies, mt19937_64& random) {
+    uniform_real_distribution<double> unit(0, 1);
+    gamma_distribution<double> radius_distribution(2, 0.4);
+    int bodies_size = bodies.size();
+    vector<double> radii(bodies_size), angles(bodies_size);
+    for (int i = 0; i < bodies_size; ++i) {
+        do {
+            radii[i] = radius_distribution(random);
+        } while (radii[i] > 0.45 * SPACE_LENGTH);
+        angles[i] = 2 * M_PI * unit(random);
+    }
+
+    // The mass inside a radius is the sum over the bodies closer to the center.
+    vector<int> order(bodies_size);
+    iota(order.begin(), order.end(), 0);
+    sort(order.begin(), order.end(), [&radii](int a, int b) { return radii[a] < radii[b]; });
+    double enclosed_mass = 0;
+    for (int i : order) {
+        body& body = bodies[i];
+        double speed = sqrt(G * enclosed_mass / max(radii[i], 0.03));
+        enclosed_mass += body.mass;
+
+        body.x_pos = clip(SPACE_LENGTH / 2 + radii[i] * cos(angles[i]));
+        body.y_pos = clip(SPACE_LENGTH / 2 + radii[i] * sin(angles[i]));
+        body.x_vel = -speed * sin(angles[i]);
+        body.y_vel = speed * cos(angles[i]);
+    }
+}
+
+/*  Generates a body file of a synthetic distribution for benchmarks.  The output is written as a binary body file if
+    its name ends in .bin and as text otherwise.  The same seed always generates the same bodies:
+        ./bin/nbody-generate plummer 100000 input/plummer-100000.bin 1
+*/
+int main(int argc, char** argv) {
+    if (argc != 4 && argc != 5) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "\t" << argv[0] << " <uniform, plummer, clustered or disk> <number of bodies> <output file name, .bin for the binary format> [seed (default: 1)]" << std::endl;
+        exit(0);
+    }
+
+    int count = atoi(argv[2]);
+    if (count <= 0) {
+        std::cerr << argv[0] << ": the number of bodies must be positive." << std::endl;
+        exit(1);
+    }
+    mt19937_64 random((argc == 5) ? strtoull(argv[4], NULL, 10) : 1);
+
+    // Every distribution draws the masses the same way.
+    vector<body> bodies(count);
+    uniform_real_distribution<double> mass(1, 5);
+    for (int i = 0; i < count; ++i) {
+        bodies[i] = body(i, 0, 0, mass(random));
+    }
+
+    if (strcmp(argv[1], "uniform") == 0) {
+        generateUniform(bodies, random);
+    } else if (strcmp(argv[1], "plummer") == 0) {
+        generatePlummer(bodies, random);
+    } else if (strcmp(argv[1], "clustered") == 0) {
+        generateClustered(bodies, random);
+    } else if (strcmp(argv[1], "disk") == 0) {
+        generateDisk(bodies, random);
+    } else {
+        std::cerr << argv[0] << ": the distribution must be uniform, plummer, clustered or disk." << std::endl;
+        exit(1);
+    }
+
+    struct options_t opts;
+    opts.output_filename = argv[3];
+    write_file(&opts, bodies);
+}
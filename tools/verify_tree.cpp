@@ -0,0 +1,135 @@
+#include <omp.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Custom Libraries
+#include "argparse.h"
+#include "bhtree.h"
+#include "body.h"
+#include "io.h"
+#include "morton.h"
+
+// namespaces
+using namespace std;
+
+// Side length of the simulated space, as main() builds the tree.
+const double SPACE_LENGTH = 4;
+
+// Leaf sizes and multipole orders every input is built with.
+const int LEAF_SIZES[] = {1, 2, 8, 32};
+const int MULTIPOLE_ORDERS[] = {0, 2};
+
+// Builds and flattens a tree of a copy of bodies with threads threads, twice to also reuse the tree's pools like a second step.
+static void buildTree(BHTree& tree, vector<body>& bodies, int threads, bool parallel) {
+    omp_set_num_threads(threads);
+    for (int build = 0; build < 2; ++build) {
+        vector<body> tree_bodies = bodies;
+        tree.buildMorton(tree_bodies, parallel);
+        tree.flatten();
+    }
+}
+
+// Builds and flattens a tree of sorted_bodies by inserting them one by one into TreeNodes, like -b insert.
+static void insertTree(BHTree& tree, vector<body>& sorted_bodies) {
+    omp_set_num_threads(1);
+    tree.reset(sorted_bodies);
+    int bodies_size = sorted_bodies.size();
+    for (int i = 0; i < bodies_size; ++i) {
+        tree.insertBody(i);
+    }
+    tree.calculateCenterOfMass();
+    tree.flatten();
+}
+
+/*  Moves every fourth body into a single cell of the deepest level of the tree, a few of them onto the same position,
+    so the cell holds more bodies than any leaf size and the tree has to stop subdividing at MORTON_BITS.
+*/
+static vector<body> stackBodies(vector<body>& bodies) {
+    vector<body> stacked = bodies;
+    double cell_length = SPACE_LENGTH / (1 << MORTON_BITS);
+    double x_center = (floor(0.3 * SPACE_LENGTH / cell_length) + 0.5) * cell_length;
+    double y_center = (floor(0.7 * SPACE_LENGTH / cell_length) + 0.5) * cell_length;
+    int stacked_size = stacked.size();
+    for (int i = 0; i < stacked_size; i += 4) {
+        stacked[i].x_pos = x_center + (i % 3) * cell_length / 8;
+        stacked[i].y_pos = y_center - (i % 5) * cell_length / 16;
+    }
+    return stacked;
+}
+
+/*  Checks the sequential Morton build of bodies against inserting its sorted bodies into TreeNodes, and the parallel
+    builds against the sequential one, for every leaf size and multipole order.  Returns the number of mismatches.
+*/
+static int verifyBodies(const char* name, vector<body>& bodies, vector<int>& thread_counts) {
+    // The Morton build sorts its bodies, so the insert build gets the same order.
+    vector<body> sorted_bodies = bodies;
+    BHTree sorting_tree(1, SPACE_LENGTH);
+    omp_set_num_threads(1);
+    sorting_tree.buildMorton(sorted_bodies, false);
+
+    int mismatches = 0;
+    for (int leaf_size : LEAF_SIZES) {
+        for (int multipole_order : MULTIPOLE_ORDERS) {
+            BHTree reference_tree(leaf_size, SPACE_LENGTH, OPENING_BMAX, multipole_order);
+            buildTree(reference_tree, bodies, 1, false);
+
+            BHTree insert_tree(leaf_size, SPACE_LENGTH, OPENING_BMAX, multipole_order);
+            insertTree(insert_tree, sorted_bodies);
+            if (!insert_tree.isEquivalent(reference_tree)) {
+                std::cerr << name << ": leaf size " << leaf_size << ", multipole order " << multipole_order << ": sequential Morton build differs from the TreeNode insert build" << std::endl;
+                ++mismatches;
+            }
+
+            for (int threads : thread_counts) {
+                BHTree tree(leaf_size, SPACE_LENGTH, OPENING_BMAX, multipole_order);
+                buildTree(tree, bodies, threads, true);
+                if (!tree.isEquivalent(reference_tree)) {
+                    std::cerr << name << ": leaf size " << leaf_size << ", multipole order " << multipole_order << ", " << threads << " threads: parallel tree build differs from the sequential build" << std::endl;
+                    ++mismatches;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+/*  Checks the sequential Morton build against the TreeNode insert build of the same sorted bodies, and the parallel
+    Morton build against the sequential one, bit for bit with BHTree::isEquivalent(), on every input and on a
+    degenerate copy of it where many bodies share the deepest cell:
+        ./bin/nbody-verify-tree input/plummer-10000.bin input/uniform-10000.bin
+    Every input is built with 1 thread and with 2, 4 and the OpenMP default of threads, for leaf sizes 1, 2, 8 and 32,
+    without and with quadrupole moments.  Exits with 1 on any mismatch.
+*/
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage:" << std::endl;
+        std::cout << "\t" << argv[0] << " <input file name>..." << std::endl;
+        exit(0);
+    }
+
+    vector<int> thread_counts = {1, 2, 4};
+    if (omp_get_max_threads() > 4) {
+        thread_counts.push_back(omp_get_max_threads());
+    }
+
+    int mismatches = 0;
+    for (int i = 1; i < argc; ++i) {
+        struct options_t opts;
+        opts.input_filename = argv[i];
+        vector<body> bodies;
+        read_file(&opts, bodies);
+
+        vector<body> stacked = stackBodies(bodies);
+        mismatches += verifyBodies(argv[i], bodies, thread_counts);
+        mismatches += verifyBodies((string(argv[i]) + " (stacked)").c_str(), stacked, thread_counts);
+    }
+
+    if (mismatches > 0) {
+        std::cerr << argv[0] << ": " << mismatches << " tree builds differ from their reference." << std::endl;
+        exit(1);
+    }
+    std::cout << argv[0] << ": every tree build matches its reference." << std::endl;
+    return 0;
+}